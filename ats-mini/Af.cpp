@@ -0,0 +1,82 @@
+#include "Common.h"
+#include "Storage.h"
+#include "Utils.h"
+#include "Af.h"
+
+//
+// RDS alternative frequencies, radio binding
+//
+// The switching logic lives in AfLogic.cpp. This file gives it access
+// to the receiver: to sample an AF, the receiver is muted (chip mute
+// only, the external mute circuit is too slow), tuned to the AF just
+// long enough to measure RSSI and tuned back.
+//
+// Audio gap of each sample and time from switching to a confirmed PI
+// code are kept in afGetStats().
+//
+
+#define AF_TUNE_POLLS   10    // Maximum tuning status polls per sample
+#define AF_POLL_TIME    2     // Tuning status polling interval (ms)
+
+static uint32_t afMillis() { return(millis()); }
+static uint32_t afMicros() { return(micros()); }
+static uint16_t afFrequency() { return(currentFrequency); }
+static bool afTune(uint16_t freq) { return(updateFrequency(freq, false)); }
+static uint16_t afPI() { return(rdsGetPI()); }
+static void afConfirmed() { prefsRequestSave(SAVE_CUR_BAND); }
+
+static uint8_t afRssi()
+{
+  uint8_t rssi, snr;
+  telemetrySignal(&rssi, &snr, TELEMETRY_MAX_AGE);
+  return(rssi);
+}
+
+//
+// Measure RSSI at given frequency and return to the current one
+//
+static uint8_t afMeasure(uint16_t freq)
+{
+  // Do not unmute what the user or squelch has muted
+  bool muted = muteOn(MUTE_MAIN) || muteOn(MUTE_SQUELCH);
+
+  if(!muted) rx.setAudioMute(true);
+
+  rx.setFrequency(freq); // Implies tuning delay
+  for(int j=0 ; j<AF_TUNE_POLLS ; j++)
+  {
+    rx.getStatus(0, 0);
+    if(rx.getTuneCompleteTriggered()) break;
+    delay(AF_POLL_TIME);
+  }
+
+  rx.getCurrentReceivedSignalQuality();
+  uint8_t result = rx.getCurrentRSSI();
+
+  rx.setFrequency(currentFrequency);
+  if(!muted) rx.setAudioMute(false);
+
+  return(result);
+}
+
+static const AfReceiver afReceiver =
+{
+  afMillis, afMicros, afFrequency, afTune, afMeasure,
+  afRssi, afPI, rdsGetAF, rdsReset, afConfirmed
+};
+
+//
+// Check alternative frequencies, returns true if the frequency has
+// changed. Called from the main loop.
+//
+bool afTickTime()
+{
+  // Sampling mutes the chip itself, which must not interfere with
+  // a mute transition in progress
+  bool enabled =
+    currentMode==FM && (getRDSMode() & RDS_AF) &&
+    !scanIsRunning() && !scanIsRadioRunning() && !seekIsRunning() &&
+    muteIsSettled();
+
+  return(afCheck(&afReceiver, enabled));
+}
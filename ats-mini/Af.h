@@ -0,0 +1,36 @@
+#ifndef AF_H
+#define AF_H
+
+#include <stdint.h>
+
+typedef struct
+{
+  uint32_t checks;           // Sampled alternative frequencies
+  uint32_t switches;         // Confirmed switches
+  uint32_t reverts;          // Switches back (wrong or no PI code)
+  uint32_t lastGap;          // Last sampling audio gap (us)
+  uint32_t maxGap;           // Longest sampling audio gap (us)
+  uint32_t lastLatency;      // Last time from switch to PI code (ms)
+} AfStats;
+
+// Receiver used by the AF logic, see Af.cpp for the radio binding
+typedef struct
+{
+  uint32_t (*millis)();                          // Current time (ms)
+  uint32_t (*micros)();                          // Current time (us)
+  uint16_t (*frequency)();                       // Current frequency (10 kHz units)
+  bool     (*tune)(uint16_t freq);               // Switch to frequency, false if refused
+  uint8_t  (*measure)(uint16_t freq);            // RSSI at frequency, then tune back
+  uint8_t  (*rssi)();                            // RSSI at current frequency
+  uint16_t (*pi)();                              // Received PI code (0 = none)
+  uint8_t  (*afs)(uint16_t *list, uint8_t max);  // Received AF list
+  void     (*rdsReset)();                        // Forget received RDS data
+  void     (*confirmed)();                       // Switch confirmed by PI code
+} AfReceiver;
+
+// AF logic (does not depend on the hardware)
+bool afCheck(const AfReceiver *rx, bool enabled);
+void afReset();
+const AfStats *afGetStats();
+
+#endif // AF_H
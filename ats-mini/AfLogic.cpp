@@ -0,0 +1,203 @@
+#include <string.h>
+#include "Af.h"
+
+//
+// RDS alternative frequencies
+//
+// AF lists received from the RDS decoder are kept per PI code. While
+// the current signal is weak, one alternative frequency is sampled at
+// a time. If the AF is clearly stronger, the receiver switches to it
+// and waits for the PI code. A different PI code, or none at all,
+// switches back and puts the AF aside for a while.
+//
+// The radio is only reached through the AfReceiver passed by the
+// caller, so this logic can be exercised with a simulated receiver.
+//
+
+#define AF_LISTS        4     // Stations with remembered AF lists
+#define AF_MAX          25    // Maximum AFs per station
+#define AF_CHECK_TIME   3000  // Time between AF checks (ms)
+#define AF_WEAK_RSSI    30    // Check AFs while RSSI is below (dBuV)
+#define AF_MARGIN       6     // AF must be this much stronger to switch (dB)
+#define AF_VERIFY_TIME  2000  // Time to get the PI code after switching (ms)
+#define AF_PENALTY      10    // Checks to skip an AF with a wrong PI code
+
+typedef struct
+{
+  uint16_t pi;            // RDS PI code (0 = unused)
+  uint8_t  count;         // Number of AFs
+  uint8_t  next;          // Next AF to check
+  uint32_t used;          // Last use time, for LRU eviction
+  uint16_t freq[AF_MAX];  // Alternative frequencies (10 kHz units)
+  uint8_t  skip[AF_MAX];  // Checks to skip
+} AfList;
+
+static AfList afLists[AF_LISTS];
+static AfStats afStats;
+
+static uint32_t afTime = 0;       // Last check time
+static uint32_t afSwitchTime = 0; // Switching time
+static uint16_t afFrom = 0;       // Frequency switched from
+static uint16_t afTo = 0;         // Frequency switched to (0 = none)
+static uint16_t afPI = 0;         // PI code expected after switching
+
+//
+// Find AF list for given PI code, creating it if needed
+//
+static AfList *afFind(uint16_t pi, bool create)
+{
+  AfList *lru = &afLists[0];
+
+  for(int j=0 ; j<AF_LISTS ; j++)
+  {
+    if(afLists[j].pi==pi) return(&afLists[j]);
+    if(afLists[j].used < lru->used) lru = &afLists[j];
+  }
+
+  if(!create) return(0);
+
+  memset(lru, 0, sizeof(*lru));
+  lru->pi = pi;
+  return(lru);
+}
+
+//
+// Merge AFs received from RDS into the list for given PI code
+//
+static AfList *afUpdate(const AfReceiver *rx, uint16_t pi, uint32_t now)
+{
+  uint16_t freqs[AF_MAX];
+  uint8_t n = rx->afs(freqs, AF_MAX);
+  AfList *list = afFind(pi, n > 0);
+
+  if(!list) return(0);
+  list->used = now;
+
+  for(int j=0 ; j<n ; j++)
+  {
+    int i;
+    for(i=0 ; i<list->count && list->freq[i]!=freqs[j] ; i++);
+    if(i==list->count && list->count<AF_MAX) list->freq[list->count++] = freqs[j];
+  }
+
+  return(list);
+}
+
+//
+// Measure RSSI at given AF, keeping audio gap statistics
+//
+static uint8_t afSample(const AfReceiver *rx, uint16_t freq)
+{
+  uint32_t start = rx->micros();
+  uint8_t result = rx->measure(freq);
+
+  afStats.lastGap = rx->micros() - start;
+  if(afStats.lastGap > afStats.maxGap) afStats.maxGap = afStats.lastGap;
+  afStats.checks++;
+
+  return(result);
+}
+
+//
+// Check received PI code after switching, returns true if the
+// receiver had to switch back
+//
+static bool afVerify(const AfReceiver *rx, uint32_t now)
+{
+  uint16_t pi = rx->pi();
+
+  // User has tuned elsewhere, nothing to verify
+  if(rx->frequency()!=afTo)
+  {
+    afTo = 0;
+    return(false);
+  }
+
+  if(pi==afPI)
+  {
+    afStats.switches++;
+    afStats.lastLatency = now - afSwitchTime;
+    afTo = 0;
+    rx->confirmed();
+    return(false);
+  }
+
+  // Keep waiting for the PI code
+  if(!pi && (now - afSwitchTime) < AF_VERIFY_TIME) return(false);
+
+  // Wrong station, put this AF aside and switch back
+  AfList *list = afFind(afPI, false);
+  for(int j=0 ; list && j<list->count ; j++)
+    if(list->freq[j]==afTo) list->skip[j] = AF_PENALTY;
+
+  rx->tune(afFrom);
+  rx->rdsReset();
+  afStats.reverts++;
+  afTo = 0;
+  afTime = now;
+  return(true);
+}
+
+//
+// Check alternative frequencies, returns true if the frequency has
+// changed. A pending switch is verified even when not enabled.
+//
+bool afCheck(const AfReceiver *rx, bool enabled)
+{
+  uint32_t now = rx->millis();
+
+  if(afTo) return(afVerify(rx, now));
+
+  if(!enabled) return(false);
+  if((now - afTime) < AF_CHECK_TIME) return(false);
+  afTime = now;
+
+  uint16_t pi = rx->pi();
+  AfList *list = pi? afUpdate(rx, pi, now) : 0;
+  if(!list || !list->count) return(false);
+
+  // Only look for a better frequency while the signal is weak
+  uint8_t curRssi = rx->rssi();
+  if(curRssi >= AF_WEAK_RSSI) return(false);
+
+  // Pick the next AF to check
+  uint16_t curFreq = rx->frequency();
+  uint16_t freq = 0;
+  for(int n=0 ; n<list->count && !freq ; n++)
+  {
+    int j = list->next++ % list->count;
+    if(list->freq[j]==curFreq) continue;
+    if(list->skip[j]) list->skip[j]--; else freq = list->freq[j];
+  }
+
+  if(!freq || afSample(rx, freq) < curRssi + AF_MARGIN) return(false);
+
+  // Switch to the AF and wait for its PI code
+  afFrom = curFreq;
+  if(!rx->tune(freq)) return(false);
+
+  afTo = rx->frequency();
+  afPI = pi;
+  afSwitchTime = now;
+  rx->rdsReset();
+  return(true);
+}
+
+//
+// Forget all AF lists, pending switches and statistics (host tests)
+//
+void afReset()
+{
+  memset(afLists, 0, sizeof(afLists));
+  memset(&afStats, 0, sizeof(afStats));
+  afTime = afSwitchTime = 0;
+  afFrom = afTo = afPI = 0;
+}
+
+//
+// Get AF switching statistics
+//
+const AfStats *afGetStats()
+{
+  return(&afStats);
+}
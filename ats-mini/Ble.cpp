@@ -1,9 +1,287 @@
 #include "Common.h"
 #include "Themes.h"
+#include "Menu.h"
 #include "Ble.h"
 
 NordicUART BLESerial = NordicUART(RECEIVER_NAME);
 
+//
+// Radio GATT service
+//
+// A structured alternative to the text commands sent over the Nordic
+// UART service, so that clients subscribe only to what they need. All
+// numbers are little endian:
+//
+//   Frequency  R/W/N  frequency (2) and BFO (2, Hz), write frequency to tune
+//   Mode       R/W/N  mode index (1)
+//   Band       R/W/N  band index (1)
+//   Volume     R/W/N  volume (1, 0-63)
+//   Signal     R/N    RSSI (1, dBuV) and SNR (1, dB)
+//   Scan       R/W/N  write offset (2) to select a chunk, or start (2, 0 =
+//                     centered), step (2) and points (2) to start a scan;
+//                     chunks are as in scanGetChunk(), completed scans are
+//                     notified chunk by chunk
+//   Memory     R/W    write slot (1) to select it, or slot (1) and memory
+//                     record (19) to set it; read slot (1) and record (19)
+//
+// Writes are posted to the radio command queue. Values are published
+// by the main loop, and notified only when they change. Selected scan
+// chunks and memories are filled in by the main loop as well, so they
+// can be read a loop pass after the selecting write.
+//
+
+#define RADIO_SERVICE_UUID  "8B3E0001-4C2D-4F6A-9E71-2A5D0C6B1F38"
+#define RADIO_FREQ_UUID     "8B3E0002-4C2D-4F6A-9E71-2A5D0C6B1F38"
+#define RADIO_MODE_UUID     "8B3E0003-4C2D-4F6A-9E71-2A5D0C6B1F38"
+#define RADIO_BAND_UUID     "8B3E0004-4C2D-4F6A-9E71-2A5D0C6B1F38"
+#define RADIO_VOLUME_UUID   "8B3E0005-4C2D-4F6A-9E71-2A5D0C6B1F38"
+#define RADIO_SIGNAL_UUID   "8B3E0006-4C2D-4F6A-9E71-2A5D0C6B1F38"
+#define RADIO_SCAN_UUID     "8B3E0007-4C2D-4F6A-9E71-2A5D0C6B1F38"
+#define RADIO_MEMORY_UUID   "8B3E0008-4C2D-4F6A-9E71-2A5D0C6B1F38"
+
+#define RADIO_FREQ          0
+#define RADIO_MODE          1
+#define RADIO_BAND          2
+#define RADIO_VOLUME        3
+#define RADIO_SIGNAL        4
+#define RADIO_SCAN          5
+#define RADIO_MEMORY        6
+#define RADIO_CHARS         7
+
+#define RADIO_SIGNAL_PERIOD 250  // Signal update period (ms)
+#define RADIO_SCAN_BURST    4    // Scan chunks notified per loop pass
+
+static const char *radioUUIDs[RADIO_CHARS] =
+{
+  RADIO_FREQ_UUID, RADIO_MODE_UUID, RADIO_BAND_UUID, RADIO_VOLUME_UUID,
+  RADIO_SIGNAL_UUID, RADIO_SCAN_UUID, RADIO_MEMORY_UUID
+};
+
+static BLEService *radioService = nullptr;
+static BLECharacteristic *radioChars[RADIO_CHARS];
+
+// Last published values
+static uint16_t radioFreq;
+static int16_t  radioBFO;
+static uint8_t  radioMode, radioBand, radioVolume, radioRssi, radioSnr;
+static uint32_t radioSignalTime;
+static uint32_t radioScanVersion;
+static int32_t  radioScanNotify = -1;  // Next scan offset to notify, or -1
+static volatile int32_t radioScanSelect = -1;   // Scan offset to select, or -1
+static volatile int16_t radioMemorySelect = -1; // Memory slot to select, or -1
+static bool     radioFresh;            // TRUE: publish everything
+
+static uint16_t radioScanPoints()
+{
+  // Chunk header takes 10 bytes, each point takes 2
+  return((BLESerial.notifyLimit() - 10) / 2);
+}
+
+//
+// Fill memory characteristic with given slot
+//
+static void radioSelectMemory(uint8_t slot)
+{
+  uint8_t buf[1 + sizeof(Memory)];
+
+  if(slot < 1 || slot > getTotalMemories()) return;
+  buf[0] = slot;
+  memcpy(buf + 1, &memories[slot - 1], sizeof(Memory));
+  radioChars[RADIO_MEMORY]->setValue(buf, sizeof(buf));
+}
+
+//
+// Fill scan characteristic with the chunk at given offset
+//
+static void radioSelectScan(uint16_t offset)
+{
+  uint8_t buf[BLE_TX_SIZE];
+  uint16_t len = scanGetChunk(buf, offset, radioScanPoints());
+  radioChars[RADIO_SCAN]->setValue(buf, len);
+}
+
+class RadioCallbacks : public BLECharacteristicCallbacks
+{
+  // Runs in the BLE task, radio changes go through the queue and
+  // selections are filled in by the main loop
+  void onWrite(BLECharacteristic *pCharacteristic, ble_gap_conn_desc *desc)
+  {
+    String value = pCharacteristic->getValue();
+    const uint8_t *data = (const uint8_t *)value.c_str();
+    size_t len = value.length();
+
+    if(pCharacteristic == radioChars[RADIO_FREQ] && len >= 2)
+      queuePost(QUEUE_TUNE, data[0] | (data[1] << 8));
+    else if(pCharacteristic == radioChars[RADIO_MODE] && len == 1 && data[0] < getTotalModes())
+      queuePost(QUEUE_SET_MODE, 0, 0, 0, bandModeDesc[data[0]]);
+    else if(pCharacteristic == radioChars[RADIO_BAND] && len == 1)
+      queuePost(QUEUE_SET_BAND, data[0]);
+    else if(pCharacteristic == radioChars[RADIO_VOLUME] && len == 1)
+      queuePost(QUEUE_SET_VOLUME, data[0]);
+    else if(pCharacteristic == radioChars[RADIO_SCAN] && len == 2)
+      radioScanSelect = data[0] | (data[1] << 8);
+    else if(pCharacteristic == radioChars[RADIO_SCAN] && len == 6)
+      queuePost(QUEUE_SCAN, data[0] | (data[1] << 8), data[2] | (data[3] << 8), data[4] | (data[5] << 8));
+    else if(pCharacteristic == radioChars[RADIO_MEMORY] && len == 1)
+      radioMemorySelect = data[0];
+    else if(pCharacteristic == radioChars[RADIO_MEMORY] && len == 1 + sizeof(Memory))
+    {
+      Memory mem;
+      char name[sizeof(mem.name) + 1];
+
+      memcpy(&mem, data + 1, sizeof(mem));
+      memcpy(name, mem.name, sizeof(mem.name));
+      name[sizeof(mem.name)] = '\0';
+      queuePost(QUEUE_SET_MEMORY, data[0], mem.freq, mem.band | (mem.mode << 8) | (mem.flags << 16), name);
+    }
+  }
+};
+
+static RadioCallbacks radioCallbacks;
+
+//
+// Create radio service on the running BLE server
+//
+static void radioStart()
+{
+  static const uint32_t props[RADIO_CHARS] =
+  {
+    BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_NOTIFY,
+    BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_NOTIFY,
+    BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_NOTIFY,
+    BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_NOTIFY,
+    BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY,
+    BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_NOTIFY,
+    BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE
+  };
+
+  radioService = BLEDevice::getServer()->createService(BLEUUID(RADIO_SERVICE_UUID), 3 * RADIO_CHARS + 1);
+  for(int j=0 ; j<RADIO_CHARS ; j++)
+  {
+    radioChars[j] = radioService->createCharacteristic(radioUUIDs[j], props[j]);
+    radioChars[j]->setCallbacks(&radioCallbacks);
+  }
+  radioService->start();
+
+  radioSelectMemory(1);
+  radioScanNotify = -1;
+  radioScanSelect = -1;
+  radioMemorySelect = -1;
+  radioFresh = true;
+}
+
+//
+// Remove radio service, before the BLE stack is shut down
+//
+static void radioStop()
+{
+  if(!radioService) return;
+
+  radioService->stop();
+  for(int j=0 ; j<RADIO_CHARS ; j++)
+  {
+    radioService->removeCharacteristic(radioChars[j], true);
+    radioChars[j] = nullptr;
+  }
+  BLEDevice::getServer()->removeService(radioService);
+  radioService = nullptr;
+}
+
+//
+// Publish changed radio values, called from the main loop
+//
+static void radioTickTime()
+{
+  uint8_t buf[BLE_TX_SIZE];
+  bool fresh = radioFresh;
+
+  radioFresh = false;
+
+  if(fresh || radioFreq!=currentFrequency || radioBFO!=currentBFO)
+  {
+    radioFreq = currentFrequency;
+    radioBFO  = currentBFO;
+    buf[0] = radioFreq;
+    buf[1] = radioFreq >> 8;
+    buf[2] = radioBFO;
+    buf[3] = radioBFO >> 8;
+    radioChars[RADIO_FREQ]->setValue(buf, 4);
+    radioChars[RADIO_FREQ]->notify();
+  }
+
+  if(fresh || radioMode!=currentMode)
+  {
+    radioMode = currentMode;
+    radioChars[RADIO_MODE]->setValue(&radioMode, 1);
+    radioChars[RADIO_MODE]->notify();
+  }
+
+  if(fresh || radioBand!=bandIdx)
+  {
+    radioBand = bandIdx;
+    radioChars[RADIO_BAND]->setValue(&radioBand, 1);
+    radioChars[RADIO_BAND]->notify();
+  }
+
+  if(fresh || radioVolume!=volume)
+  {
+    radioVolume = volume;
+    radioChars[RADIO_VOLUME]->setValue(&radioVolume, 1);
+    radioChars[RADIO_VOLUME]->notify();
+  }
+
+  if(fresh || (millis() - radioSignalTime) >= RADIO_SIGNAL_PERIOD)
+  {
+    uint8_t rssi, snr;
+
+    radioSignalTime = millis();
+    telemetrySignal(&rssi, &snr, TELEMETRY_MAX_AGE);
+    if(fresh || rssi!=radioRssi || snr!=radioSnr)
+    {
+      radioRssi = buf[0] = rssi;
+      radioSnr  = buf[1] = snr;
+      radioChars[RADIO_SIGNAL]->setValue(buf, 2);
+      radioChars[RADIO_SIGNAL]->notify();
+    }
+  }
+
+  // Fill in selections written by the client
+  int32_t offset = radioScanSelect;
+  if(offset >= 0)
+  {
+    radioScanSelect = -1;
+    radioSelectScan(offset);
+  }
+
+  int16_t slot = radioMemorySelect;
+  if(slot >= 0)
+  {
+    radioMemorySelect = -1;
+    radioSelectMemory(slot);
+  }
+
+  // Notify completed scans a few chunks at a time
+  if(scanIsReady() && radioScanVersion!=scanGetVersion())
+  {
+    radioScanVersion = scanGetVersion();
+    radioScanNotify = 0;
+  }
+
+  for(int j=0 ; j<RADIO_SCAN_BURST && radioScanNotify>=0 ; j++)
+  {
+    uint16_t len = scanGetChunk(buf, radioScanNotify, radioScanPoints());
+    if(len <= 10)
+    {
+      radioScanNotify = -1;
+      break;
+    }
+
+    radioChars[RADIO_SCAN]->setValue(buf, len);
+    radioChars[RADIO_SCAN]->notify();
+    radioScanNotify += (len - 10) / 2;
+  }
+}
+
 //
 // Get current connection status
 // (-1 - not connected, 0 - disabled, 1 - connected)
@@ -20,6 +298,7 @@ int8_t getBleStatus()
 void bleStop()
 {
   if(!BLESerial.isStarted()) return;
+  radioStop();
   BLESerial.stop();
 }
 
@@ -28,18 +307,37 @@ void bleInit(uint8_t bleMode)
   bleStop();
 
   if(bleMode == BLE_OFF) return;
-  BLESerial.start();
+  BLESerial.start(radioStart);
 }
 
+//
+// Send data to the connected BLE client, if any
+//
+void bleWrite(const uint8_t *data, size_t len)
+{
+  if(getBleStatus() > 0) BLESerial.write(data, len);
+}
+
+//
+// BLE input and output stream, for the remote commands
+//
+Stream *bleStream()
+{
+  return(&BLESerial);
+}
+
+//
+// Execute received BLE commands and send out collected output
+// Returns REMOTE_* events
+//
 int bleDoCommand(uint8_t bleMode)
 {
-  if(bleMode == BLE_OFF) return 0;
+  if(bleMode == BLE_OFF || getBleStatus() <= 0) return 0;
 
-  if (BLEDevice::getServer()->getConnectedCount() > 0) {
-    if (BLESerial.available()) {
-      char bleChar = BLESerial.read();
-      BLESerial.write(bleChar);
-    }
-  }
-  return 0;
+  radioTickTime();
+
+  // Packets may carry several commands, execute them one per call
+  int event = BLESerial.available() ? remoteReceive(REMOTE_BLE) : 0;
+  BLESerial.flush();
+  return event;
 }
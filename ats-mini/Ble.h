@@ -5,13 +5,16 @@
 #include <BLEServer.h>
 #include <BLEUtils.h>
 #include <BLE2902.h>
-#include <semaphore>
 
 #define NORDIC_UART_SERVICE_UUID           "6E400001-B5A3-F393-E0A9-E50E24DCCA9E"
 #define NORDIC_UART_CHARACTERISTIC_UUID_RX "6E400002-B5A3-F393-E0A9-E50E24DCCA9E"
 #define NORDIC_UART_CHARACTERISTIC_UUID_TX "6E400003-B5A3-F393-E0A9-E50E24DCCA9E"
 
-class NordicUART : public BLEServerCallbacks, public BLECharacteristicCallbacks {
+#define BLE_RX_SIZE  512 // Receive buffer size
+#define BLE_TX_SIZE  244 // Largest notification (247 byte MTU)
+#define BLE_TX_MIN   20  // Notification size with the default MTU
+
+class NordicUART : public Stream, public BLEServerCallbacks, public BLECharacteristicCallbacks {
 private:
   // BLE components
   BLEServer* pServer;
@@ -22,10 +25,20 @@ private:
   // Connection management
   bool started;
 
-  // Data handling
-  std::binary_semaphore dataConsumed{1};
-  String incomingPacket;
-  size_t unreadByteCount = 0;
+  // Received data, written by the BLE task and read by the main loop
+  portMUX_TYPE rxLock = portMUX_INITIALIZER_UNLOCKED;
+  uint8_t rxBuf[BLE_RX_SIZE];
+  uint16_t rxHead = 0;
+  uint16_t rxTail = 0;
+
+  // Outgoing data, collected into notifications as large as the MTU allows
+  uint8_t txBuf[BLE_TX_SIZE];
+  uint16_t txLen = 0;
+  uint16_t txLimit = BLE_TX_MIN;
+
+  // Set by the BLE task, applied by flush() in the main loop
+  volatile uint16_t txNextLimit = BLE_TX_MIN;
+  volatile bool txReset = false;
 
   // Device attributes
   const char *deviceName;
@@ -39,7 +52,8 @@ public:
     pRxCharacteristic = nullptr;
   }
 
-  void start()
+  // Extra services are added before advertising starts
+  void start(void (*addServices)() = nullptr)
   {
     BLEDevice::init(deviceName);
     BLEDevice::setPower(ESP_PWR_LVL_N0); // N12, N9, N6, N3, N0, P3, P6, P9
@@ -57,6 +71,7 @@ public:
     pRxCharacteristic = pService->createCharacteristic(NORDIC_UART_CHARACTERISTIC_UUID_RX, BLECharacteristic::PROPERTY_WRITE);
     pRxCharacteristic->setCallbacks(this); // onWrite
     pService->start();
+    if (addServices) addServices();
     pServer->getAdvertising()->start();
     started = true;
   }
@@ -87,63 +102,116 @@ public:
     return started;
   }
 
+  // Largest notification the connected client can take
+  uint16_t notifyLimit()
+  {
+    return txLimit;
+  }
+
   void onConnect(BLEServer *pServer) {
   }
 
   void onDisconnect(BLEServer *pServer) {
-    dataConsumed.release();
+    portENTER_CRITICAL(&rxLock);
+    rxHead = rxTail = 0;
+    portEXIT_CRITICAL(&rxLock);
+    txNextLimit = BLE_TX_MIN;
+    txReset = true;
     pServer->getAdvertising()->start();
   }
 
+  void onMtuChanged(BLEServer *pServer, ble_gap_conn_desc *desc, uint16_t mtu) {
+    txNextLimit = constrain(mtu - 3, BLE_TX_MIN, BLE_TX_SIZE);
+  }
+
   // FIXME https://github.com/espressif/arduino-esp32/issues/11805
   void onWrite(BLECharacteristic *pCharacteristic, ble_gap_conn_desc *desc)
   {
     if(pCharacteristic == pRxCharacteristic)
     {
-      // Wait for previous data to get consumed
-      dataConsumed.acquire();
-
-      // Hold data until next read
-      incomingPacket = pCharacteristic->getValue();
-      unreadByteCount = incomingPacket.length();
+      String packet = pCharacteristic->getValue();
+
+      // Queue the whole packet, dropping whatever does not fit
+      portENTER_CRITICAL(&rxLock);
+      for(size_t i = 0; i < packet.length(); i++)
+      {
+        uint16_t next = (rxHead + 1) % BLE_RX_SIZE;
+        if(next == rxTail) break;
+        rxBuf[rxHead] = packet[i];
+        rxHead = next;
+      }
+      portEXIT_CRITICAL(&rxLock);
     }
   }
 
   int available()
   {
-    return unreadByteCount;
+    portENTER_CRITICAL(&rxLock);
+    int result = (rxHead + BLE_RX_SIZE - rxTail) % BLE_RX_SIZE;
+    portEXIT_CRITICAL(&rxLock);
+    return result;
+  }
+
+  int peek()
+  {
+    portENTER_CRITICAL(&rxLock);
+    int result = rxHead != rxTail ? rxBuf[rxTail] : -1;
+    portEXIT_CRITICAL(&rxLock);
+    return result;
   }
 
   int read()
   {
-    if (unreadByteCount > 0)
+    portENTER_CRITICAL(&rxLock);
+    int result = -1;
+    if (rxHead != rxTail)
     {
-      size_t index = incomingPacket.length() - unreadByteCount;
-      int result = incomingPacket[index];
-      unreadByteCount--;
-      if (unreadByteCount == 0)
-        dataConsumed.release();
-      return result;
+      result = rxBuf[rxTail];
+      rxTail = (rxTail + 1) % BLE_RX_SIZE;
     }
-    return -1;
+    portEXIT_CRITICAL(&rxLock);
+    return result;
   }
 
-  size_t write(uint8_t *data, size_t size)
+  // Collect data, sending a notification whenever one is full
+  size_t write(const uint8_t *data, size_t size)
   {
-   if (pTxCharacteristic)
-   {
-     pTxCharacteristic->setValue(data, size);
-     pTxCharacteristic->notify();
-     return size;
-   }
-   else
-      return 0;
+    if (!pTxCharacteristic) return 0;
+
+    for (size_t done = 0; done < size; )
+    {
+      size_t n = min((size_t)(txLimit - txLen), size - done);
+      memcpy(txBuf + txLen, data + done, n);
+      txLen += n;
+      done += n;
+      if (txLen >= txLimit) flush();
+    }
+    return size;
   }
 
   size_t write(uint8_t byte)
   {
     return write(&byte, 1);
   };
+
+  // Send collected data, then apply connection changes while empty
+  void flush()
+  {
+    if (txReset)
+    {
+      // Drop data collected for a client that has gone
+      txReset = false;
+      txLen = 0;
+    }
+
+    if (pTxCharacteristic && txLen)
+    {
+      pTxCharacteristic->setValue(txBuf, txLen);
+      pTxCharacteristic->notify();
+    }
+    txLen = 0;
+    txLimit = txNextLimit;
+  }
 };
 
 #endif
@@ -0,0 +1,335 @@
+#include "Common.h"
+#include "Draw.h"
+#include <esp_heap_caps.h>
+
+//
+// Screen capture
+//
+// Screenshots are built straight from the sprite buffer as 16bpp BMP
+// images. The serial console gets either the original HEX dump or a
+// binary RLE stream, HTTP clients get a plain BMP file.
+//
+// Web handlers run in their own task, so they can not read the sprite
+// while the main loop draws into it. Instead, drawPushSprite() copies
+// every completed frame into a snapshot buffer for a while after a
+// screenshot has been requested. The snapshot is guarded by a sequence
+// counter: it is odd while the copy is being updated, and readers retry
+// if it has changed while they were copying.
+//
+// While WebSocket viewers are connected, every pushed frame is also sent
+// to them as a list of changed rectangles, using the same tiles that
+// drawPushSprite() uses to update the display. Each rectangle is made of
+// x, y, width and height (16-bit little endian), followed by its rows
+// packed as in the binary serial screenshot. When viewers can not keep
+// up, frames are dropped and the next frame is sent whole.
+//
+
+#define CAPTURE_WIDTH   320   // Screen width
+#define CAPTURE_HEIGHT  170   // Screen height
+#define CAPTURE_HEADER  66    // BMP header size, including color masks
+#define CAPTURE_HOLD    3000  // Keep taking snapshots after a request (ms)
+#define CAPTURE_WAIT    300   // Maximum time to wait for a fresh frame (ms)
+#define CAPTURE_POLL_MS 5     // Frame polling interval (ms)
+
+#define CAPTURE_PIXELS  (CAPTURE_WIDTH * CAPTURE_HEIGHT)
+#define CAPTURE_BMP     (CAPTURE_HEADER + CAPTURE_PIXELS * 2)
+#define CAPTURE_MIRROR  (CAPTURE_PIXELS * 2 + 4096) // Worst case mirror message
+
+static uint16_t * volatile captureSnap = 0;    // Last frame (sprite format)
+static volatile uint32_t captureSeq = 0;       // Snapshot sequence counter
+static volatile uint32_t captureRequest = 0;   // Last screenshot request time
+static volatile bool captureWanted = false;    // TRUE: snapshots requested
+static uint8_t *mirrorBuf = 0;                 // Mirror message buffer
+static volatile bool mirrorFull = true;        // TRUE: send whole next frame
+
+static inline uint16_t swapColor(uint16_t c) { return((c >> 8) | (c << 8)); }
+
+static inline void put16(uint8_t *p, uint16_t v)
+{
+  p[0] = v; p[1] = v >> 8;
+}
+
+static inline void put32(uint8_t *p, uint32_t v)
+{
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+//
+// Fill BMP header (16bpp with RGB565 bit fields), returns header size
+//
+static int captureHeader(uint8_t *buf)
+{
+  memset(buf, 0, CAPTURE_HEADER);
+
+  // File header
+  buf[0] = 'B';
+  buf[1] = 'M';
+  put32(buf + 2, CAPTURE_BMP);
+  put32(buf + 10, CAPTURE_HEADER);
+
+  // Image header
+  put32(buf + 14, 40);
+  put32(buf + 18, CAPTURE_WIDTH);
+  put32(buf + 22, CAPTURE_HEIGHT);
+  buf[26] = 1;                 // 1 plane
+  buf[28] = 16;                // 16 bpp
+  buf[30] = 3;                 // Bit fields
+
+  // Color masks
+  put32(buf + 54, 0xF800);
+  put32(buf + 58, 0x07E0);
+  put32(buf + 62, 0x001F);
+
+  return(CAPTURE_HEADER);
+}
+
+//
+// Pack a row of BMP pixels: a control byte N < 128 is followed by N+1
+// literal pixels, N >= 128 is followed by one pixel repeated N-125 times
+//
+static int captureRleRow(const uint16_t *img, int width, uint8_t *out)
+{
+  uint8_t *p = out;
+
+  for(int x=0 ; x<width ; )
+  {
+    uint16_t c = img[x];
+    int run = 1;
+
+    while(x+run<width && run<130 && img[x+run]==c) run++;
+
+    if(run >= 3)
+    {
+      // Repeated pixel (sprite keeps big endian colors, BMP is little endian)
+      *p++ = run + 125;
+      *p++ = c >> 8;
+      *p++ = c;
+      x += run;
+    }
+    else
+    {
+      // Literal pixels, until the next run of three
+      int n = 0;
+      uint8_t *ctl = p++;
+
+      while(x<width && n<128)
+      {
+        if(x+2<width && img[x]==img[x+1] && img[x]==img[x+2]) break;
+        *p++ = img[x] >> 8;
+        *p++ = img[x];
+        x++, n++;
+      }
+
+      *ctl = n - 1;
+    }
+  }
+
+  return(p - out);
+}
+
+//
+// Dump screen to the serial port, as HEX text or binary RLE stream
+// Called from the main loop only
+//
+void captureSerial(bool rle)
+{
+  static const char hex[] = "0123456789abcdef";
+  const uint16_t *img = (const uint16_t *)spr.getPointer();
+  uint8_t buf[CAPTURE_WIDTH * 4 + 2];
+
+  if(!img) return;
+
+  Serial.println("");
+
+  // BMP header
+  int n = captureHeader(buf);
+  if(rle)
+    Serial.write(buf, n);
+  else
+  {
+    char text[CAPTURE_HEADER * 2];
+    for(int j=0 ; j<n ; j++)
+    {
+      text[j * 2] = hex[buf[j] >> 4];
+      text[j * 2 + 1] = hex[buf[j] & 15];
+    }
+    Serial.write(text, n * 2);
+    Serial.println("");
+  }
+
+  // Image data, bottom to top
+  for(int y=CAPTURE_HEIGHT-1 ; y>=0 ; y--)
+  {
+    const uint16_t *row = img + y * CAPTURE_WIDTH;
+
+    if(rle)
+      n = captureRleRow(row, CAPTURE_WIDTH, buf);
+    else
+    {
+      // Sprite keeps big endian colors, print them as little endian
+      n = 0;
+      for(int x=0 ; x<CAPTURE_WIDTH ; x++)
+      {
+        uint16_t c = row[x];
+        buf[n++] = hex[c >> 12];
+        buf[n++] = hex[(c >> 8) & 15];
+        buf[n++] = hex[(c >> 4) & 15];
+        buf[n++] = hex[c & 15];
+      }
+      buf[n++] = '\r';
+      buf[n++] = '\n';
+    }
+
+    Serial.write(buf, n);
+  }
+}
+
+//
+// Pack a rectangle into a mirror message, returns packed size
+//
+static int mirrorRect(uint8_t *out, const uint16_t *img, int x, int y, int w, int h)
+{
+  uint8_t *p = out;
+
+  put16(p, x);
+  put16(p + 2, y);
+  put16(p + 4, w);
+  put16(p + 6, h);
+  p += 8;
+
+  for(int j=0 ; j<h ; j++)
+    p += captureRleRow(img + (y + j) * CAPTURE_WIDTH + x, w, p);
+
+  return(p - out);
+}
+
+//
+// Send changed tiles to the mirror viewers
+//
+static void mirrorSend(const uint16_t *img, const uint32_t *dirty)
+{
+  if(!mirrorBuf)
+  {
+    mirrorBuf = (uint8_t *)heap_caps_malloc(CAPTURE_MIRROR, MALLOC_CAP_SPIRAM);
+    if(!mirrorBuf) return;
+  }
+
+  uint8_t *p = mirrorBuf;
+
+  // Clear the flag first, so that a viewer connecting meanwhile
+  // still gets a whole frame next time
+  if(mirrorFull)
+  {
+    mirrorFull = false;
+    p += mirrorRect(p, img, 0, 0, CAPTURE_WIDTH, CAPTURE_HEIGHT);
+  }
+  else
+  {
+    // Runs of adjacent changed tiles
+    for(int ty=0 ; ty<TILES_Y ; ty++)
+      for(int tx=0, start=-1 ; tx<=TILES_X ; tx++)
+      {
+        bool d = tx<TILES_X && (dirty[ty] & (1 << tx));
+        if(d && start<0) start = tx;
+        else if(!d && start>=0)
+        {
+          p += mirrorRect(p, img, start * TILE_W, ty * TILE_H, (tx - start) * TILE_W, TILE_H);
+          start = -1;
+        }
+      }
+  }
+
+  // Viewers have missed this frame, resend everything next time
+  if(p!=mirrorBuf && !netScreenSend(mirrorBuf, p - mirrorBuf))
+    mirrorFull = true;
+}
+
+//
+// Ask for a whole frame to be sent to the mirror viewers
+// Safe to call from any task, but not from an ISR
+//
+void captureMirrorRefresh()
+{
+  mirrorFull = true;
+  queuePost(QUEUE_REDRAW);
+}
+
+//
+// Take a completed frame, with dirty tile bits per tile row
+// Called from drawPushSprite() in the main loop
+//
+void captureUpdate(const uint16_t *img, const uint32_t *dirty)
+{
+  if(netScreenClients()) mirrorSend(img, dirty);
+
+  if(!captureWanted) return;
+
+  // Stop taking snapshots when nobody asks for them anymore
+  if((millis() - captureRequest) > CAPTURE_HOLD)
+  {
+    captureWanted = false;
+    return;
+  }
+
+  if(!captureSnap)
+  {
+    captureSnap = (uint16_t *)heap_caps_malloc(CAPTURE_PIXELS * 2, MALLOC_CAP_SPIRAM);
+    if(!captureSnap) return;
+  }
+
+  captureSeq++;
+  __sync_synchronize();
+  memcpy(captureSnap, img, CAPTURE_PIXELS * 2);
+  __sync_synchronize();
+  captureSeq++;
+}
+
+//
+// Get a BMP image of the current screen, returns buffer to be freed
+// with heap_caps_free() or 0 on failure. Must not be called from the
+// main loop, as it waits for the main loop to draw a fresh frame.
+//
+uint8_t *captureBmp(size_t *size)
+{
+  uint8_t *bmp = (uint8_t *)heap_caps_malloc(CAPTURE_BMP, MALLOC_CAP_SPIRAM);
+  if(!bmp) return(0);
+
+  // Ask the main loop for a fresh frame
+  uint32_t seq = captureSeq;
+  captureRequest = millis();
+  captureWanted = true;
+  queuePost(QUEUE_REDRAW);
+
+  for(uint32_t start=millis() ; captureSeq==seq && (millis()-start)<CAPTURE_WAIT ; )
+    vTaskDelay(pdMS_TO_TICKS(CAPTURE_POLL_MS));
+
+  // No frame has been drawn (i.e. display is sleeping), use sprite as is
+  const uint16_t *src = captureSnap && captureSeq? captureSnap : (const uint16_t *)spr.getPointer();
+  if(!src)
+  {
+    heap_caps_free(bmp);
+    return(0);
+  }
+
+  uint16_t *pixels = (uint16_t *)(bmp + captureHeader(bmp));
+
+  for(int retry=0 ; retry<3 ; retry++)
+  {
+    seq = captureSeq;
+    __sync_synchronize();
+
+    // Flip rows and convert colors to little endian
+    for(int y=0 ; y<CAPTURE_HEIGHT ; y++)
+    {
+      const uint16_t *row = src + (CAPTURE_HEIGHT - 1 - y) * CAPTURE_WIDTH;
+      uint16_t *dst = pixels + y * CAPTURE_WIDTH;
+      for(int x=0 ; x<CAPTURE_WIDTH ; x++) dst[x] = swapColor(row[x]);
+    }
+
+    __sync_synchronize();
+    if(src!=captureSnap || (!(seq & 1) && seq==captureSeq)) break;
+  }
+
+  *size = CAPTURE_BMP;
+  return(bmp);
+}
@@ -36,6 +36,7 @@
 #define RDS_RT        0b00001000  // Radio text
 #define RDS_PT        0b00010000  // Program type
 #define RDS_RBDS      0b00100000  // Use US PTYs
+#define RDS_AF        0b01000000  // Follow alternative frequencies
 
 // Sleep modes
 #define SLEEP_LOCKED   0 // Lock the encoder
@@ -164,6 +165,7 @@ extern bool zoomMenu;
 extern int8_t scrollDirection;
 extern uint8_t utcOffsetIdx;
 extern uint8_t uiLayoutIdx;
+extern uint8_t scanZoomIdx;
 
 // Info panel menu state
 extern uint8_t infoPanelIdx;      // Current cursor position (0-based)
@@ -195,7 +197,11 @@ static inline bool isSSB() { return(currentMode>FM && currentMode<AM); }
 
 void useBand(const Band *band);
 bool updateBFO(int newBFO, bool wrap = true);
-bool doSeek(int16_t enc);
+bool updateFrequency(int newFreq, bool wrap);
+bool doSeek(int16_t enc, int16_t enca);
+bool seekIsRunning();
+void seekCancel();
+void seekAbort();
 bool clickFreq(bool shortPress);
 uint8_t doAbout(int16_t enc);
 bool checkStopSeeking();
@@ -214,6 +220,13 @@ uint16_t scanGetStartFreq();
 uint16_t scanGetStep();
 uint16_t scanGetCount();
 bool scanGetDataPoint(uint16_t index, uint8_t *rssi, uint8_t *snr);
+bool scanGetPointAt(uint16_t freq, uint8_t *rssi, uint8_t *snr);
+void scanGetRange(uint8_t *minRSSI, uint8_t *maxRSSI, uint8_t *minSNR, uint8_t *maxSNR);
+uint16_t scanGetExtent(uint16_t *startFreq, uint16_t *endFreq);
+bool scanGetSpan(uint16_t freq1, uint16_t freq2, uint8_t *minRSSI, uint8_t *maxRSSI, uint8_t *minSNR, uint8_t *maxSNR);
+uint32_t scanGetVersion();
+uint32_t scanGetEpoch();
+uint16_t scanGetChunk(uint8_t *buf, uint16_t offset, uint16_t count);
 void scanStartAsync(uint16_t centerFreq, uint16_t step, uint16_t points);
 void scanStartAsyncFrom(uint16_t startFreq, uint16_t step, uint16_t points);
 bool scanTickAsync();
@@ -222,6 +235,21 @@ void scanSaveToBandCache(uint8_t bandIndex);
 bool scanLoadFromBandCache(uint8_t bandIndex);
 bool scanHasDataForBand(uint8_t bandIndex);
 void scanInvalidateBandCache(uint8_t bandIndex);
+uint16_t scanFindStation(uint8_t bandIndex, uint16_t freq, int8_t dir, uint8_t *threshold);
+
+// Station found by a scan
+#define SCAN_PEAKS  48        // Maximum stations found per scan
+
+typedef struct
+{
+  uint16_t freq;             // Estimated center frequency
+  uint16_t tune;             // Strongest scanned frequency, tune here
+  uint8_t  rssi;             // Strongest RSSI (dBuV)
+  uint8_t  snr;              // Best SNR (dB)
+} ScanPeak;
+
+uint8_t scanGetPeaks(uint8_t bandIndex, const ScanPeak **peaks, uint32_t *time);
+uint8_t scanCopyPeaks(uint8_t bandIndex, ScanPeak *peaks, uint8_t max, uint32_t *time);
 
 // Progressive radio scan functions
 void scanStartRadio();
@@ -251,6 +279,38 @@ bool identifyFrequency(uint16_t freq, bool periodic = false);
 const char *findMemoryName(uint32_t freq, uint8_t mode);
 bool isMemoryFavorite(uint32_t freq, uint8_t mode);
 
+// Rds.cpp
+typedef struct
+{
+  uint32_t groups;           // Decoded groups
+  uint32_t groupTypes[32];   // Groups per type (0A, 0B, 1A, ...)
+  uint32_t blocks;           // Received blocks
+  uint32_t blocksCorrected;  // Blocks with corrected errors
+  uint32_t blocksBad;        // Uncorrectable blocks
+  uint32_t groupsLost;       // Groups lost to FIFO overflow
+  uint32_t syncLost;         // Synchronization losses
+  uint8_t  quality;          // Usable blocks, recent average (%)
+} RdsStats;
+
+void rdsReset();
+bool rdsPoll();
+uint16_t rdsGetPI();
+int rdsGetPTY();
+const char *rdsGetPS();
+const char *rdsGetRT();
+bool rdsGetTime(uint8_t *hours, uint8_t *minutes);
+uint8_t rdsGetAF(uint16_t *list, uint8_t max);
+const RdsStats *rdsGetStats();
+
+// Af.cpp
+bool afTickTime();
+
+// StationDb.cpp
+void stationDbInit();
+void stationDbTickTime();
+bool stationDbLookup(uint16_t freq, uint16_t pi, const char **ps, int *pty);
+void stationDbStore(uint16_t freq, uint16_t pi, const char *ps, int pty);
+
 // Network.cpp
 int8_t getWiFiStatus();
 char *getWiFiIPAddress();
@@ -262,21 +322,71 @@ bool ntpSyncTime();
 
 void netRequestConnect();
 void netTickTime();
+bool netScreenClients();
+bool netScreenSend(const uint8_t *data, size_t len);
+void netTelemetrySend(const char *data, size_t len);
 
 // Ble.cpp
 int bleDoCommand(uint8_t bleModeIdx);
 void bleInit(uint8_t bleMode);
 void bleStop();
 int8_t getBleStatus();
+void bleWrite(const uint8_t *data, size_t len);
+Stream *bleStream();
 
 // Remote.c
 #define REMOTE_CHANGED   1
 #define REMOTE_CLICK     2
 #define REMOTE_PREFS     4
 #define REMOTE_DIRECTION 8
+#define REMOTE_SERIAL    0
+#define REMOTE_BLE       1
 void remoteTickTime();
 int remoteDoCommand(char key);
-char readSerialChar();
+int remoteReceive(uint8_t source);
+
+// Capture.cpp
+void captureSerial(bool rle);
+void captureUpdate(const uint16_t *img, const uint32_t *dirty);
+uint8_t *captureBmp(size_t *size);
+void captureMirrorRefresh();
+
+// Telemetry.cpp
+#define TELEMETRY_SERIAL 0
+#define TELEMETRY_BLE    1
+#define TELEMETRY_WS     2
+#define TELEMETRY_SINKS  3
+#define TELEMETRY_MAX_AGE 50 // Reuse signal samples younger than this (ms)
+void telemetrySignal(uint8_t *rssi, uint8_t *snr, uint32_t maxAge);
+uint16_t telemetryCapacitor(uint32_t maxAge);
+uint16_t telemetryVoltage();
+void telemetryCached(uint8_t *rssi, uint8_t *snr, uint16_t *cap, uint16_t *voltage);
+void telemetrySubscribe(uint8_t sink, uint16_t period, uint8_t fields);
+bool telemetryConfigure(uint8_t sink, const char *args);
+void telemetryTickTime();
+
+// Protocol.cpp
+bool protoIsPending();
+int protoReceive();
+void protoTickTime();
+
+// Queue.cpp
+#define QUEUE_TUNE          1 // Tune to frequency arg1, result as tuneToFrequency()
+#define QUEUE_TUNE_STEP     2 // Tune by arg1 steps, result 0
+#define QUEUE_KEY           3 // Remote command key arg1, result as remoteDoCommand()
+#define QUEUE_MEMORY        4 // Recall memory slot arg1, result 0 or -1
+#define QUEUE_SET_BAND      5 // Select band by name (or index arg1 if no name), result as setBandByName()
+#define QUEUE_SET_MODE      6 // Select mode by name, result as setModeByName()
+#define QUEUE_SET_STEP      7 // Select step by name, result as setStepByName()
+#define QUEUE_SET_BANDWIDTH 8 // Select bandwidth by name, result as setBandwidthByName()
+#define QUEUE_SET_AGC       9 // Set AGC value arg1, result 0 or -1
+#define QUEUE_SCAN         10 // Async scan from arg1 (0=centered), step arg2, arg3 points, result 0 or 1 if running
+#define QUEUE_REDRAW       11 // Redraw screen, result 0
+#define QUEUE_SET_VOLUME   12 // Set volume arg1, result 0 or -1
+#define QUEUE_SET_MEMORY   13 // Set memory slot arg1 to freq arg2, band|mode<<8|flags<<16 arg3, name, result 0 or -1
+uint32_t queuePost(uint8_t type, int32_t arg1 = 0, int32_t arg2 = 0, int32_t arg3 = 0, const char *name = 0);
+bool queueWait(uint32_t ticket, int32_t *result, uint32_t timeout);
+bool queueTickTime();
 
 // ats-mini.ino
 bool doTune(int16_t enc);
@@ -5,6 +5,232 @@
 #include "Menu.h"
 #include "Draw.h"
 
+#ifdef LCD_DMA
+#include <esp_lcd_panel_io.h>
+#include <esp_heap_caps.h>
+#endif
+
+//
+// Dirty region tracking
+//
+// The screen is composed in the sprite as a whole, but only the parts
+// that changed since the last push get sent over SPI. The sprite is
+// split into tiles and a hash of each tile, as it was last pushed, is
+// kept. Adjacent changed tiles in a row get pushed as a single window.
+//
+#define TILES_FULL    (TILES_X * TILES_Y * 3 / 4) // Push whole sprite above this
+
+static uint32_t tileHash[TILES_Y][TILES_X];
+static bool tilesValid = false;
+
+#ifdef LCD_DMA
+//
+// DMA display transfers
+//
+// TFT_eSPI drives the 8-bit parallel bus by toggling GPIOs, so the CPU
+// is busy for the whole transfer. With LCD_DMA, the bus is handed over
+// to the ESP32-S3 LCD peripheral once TFT_eSPI has initialized the
+// display. Pixels are copied from the sprite into one of two bounce
+// buffers in internal RAM and sent by DMA, while the next chunk is being
+// copied. The last chunk of a frame is still being sent while the next
+// frame is composed.
+//
+#define LCD_PCLK_HZ     (10 * 1000 * 1000)  // Write strobe frequency
+#define LCD_ROW_OFFSET  35                  // 170 rows panel is centered in 240 rows RAM
+#define LCD_CHUNK       (320 * TILE_H)      // Bounce buffer size (pixels)
+
+static esp_lcd_panel_io_handle_t lcdIO = 0;
+static uint16_t *lcdBuf[2] = { 0, 0 };
+static uint8_t lcdBufIdx = 0;
+
+static bool lcdInit()
+{
+  esp_lcd_i80_bus_handle_t bus = 0;
+  esp_lcd_i80_bus_config_t busConfig = {};
+  esp_lcd_panel_io_i80_config_t ioConfig = {};
+  const int dataPins[8] = { TFT_D0, TFT_D1, TFT_D2, TFT_D3, TFT_D4, TFT_D5, TFT_D6, TFT_D7 };
+
+  lcdBuf[0] = (uint16_t *)heap_caps_malloc(LCD_CHUNK * 2, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+  lcdBuf[1] = (uint16_t *)heap_caps_malloc(LCD_CHUNK * 2, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+  if(!lcdBuf[0] || !lcdBuf[1]) goto fail;
+
+  busConfig.dc_gpio_num = TFT_DC;
+  busConfig.wr_gpio_num = TFT_WR;
+  busConfig.clk_src = LCD_CLK_SRC_DEFAULT;
+  for(int j=0 ; j<8 ; j++) busConfig.data_gpio_nums[j] = dataPins[j];
+  busConfig.bus_width = 8;
+  busConfig.max_transfer_bytes = LCD_CHUNK * 2;
+  if(esp_lcd_new_i80_bus(&busConfig, &bus) != ESP_OK) goto fail;
+
+  ioConfig.cs_gpio_num = TFT_CS;
+  ioConfig.pclk_hz = LCD_PCLK_HZ;
+  ioConfig.trans_queue_depth = 2;
+  ioConfig.lcd_cmd_bits = 8;
+  ioConfig.lcd_param_bits = 8;
+  ioConfig.dc_levels.dc_data_level = 1;
+  if(esp_lcd_new_panel_io_i80(bus, &ioConfig, &lcdIO) != ESP_OK)
+  {
+    esp_lcd_del_i80_bus(bus);
+    goto fail;
+  }
+
+  return(true);
+
+fail:
+  heap_caps_free(lcdBuf[0]);
+  heap_caps_free(lcdBuf[1]);
+  lcdBuf[0] = lcdBuf[1] = 0;
+  lcdIO = 0;
+  return(false);
+}
+
+static void lcdPushRect(const uint16_t *img, int x, int y, int w, int h)
+{
+  uint16_t *buf = lcdBuf[lcdBufIdx];
+  lcdBufIdx ^= 1;
+
+  // This buffer is not in flight, copy pixels while the other one is
+  for(int j=0 ; j<h ; j++)
+    memcpy(buf + j * w, img + (y + j) * 320 + x, w * 2);
+
+  uint16_t x1 = x + w - 1;
+  uint16_t y0 = y + LCD_ROW_OFFSET;
+  uint16_t y1 = y0 + h - 1;
+  uint8_t cols[4] = { (uint8_t)(x >> 8), (uint8_t)x, (uint8_t)(x1 >> 8), (uint8_t)x1 };
+  uint8_t rows[4] = { (uint8_t)(y0 >> 8), (uint8_t)y0, (uint8_t)(y1 >> 8), (uint8_t)y1 };
+
+  // Parameter writes wait for the previous color transfer to finish
+  esp_lcd_panel_io_tx_param(lcdIO, TFT_CASET, cols, 4);
+  esp_lcd_panel_io_tx_param(lcdIO, TFT_PASET, rows, 4);
+  esp_lcd_panel_io_tx_color(lcdIO, TFT_RAMWR, buf, w * h * 2);
+}
+#endif // LCD_DMA
+
+//
+// Initialize display transfers, call after the display has been set up
+//
+void drawInit()
+{
+#ifdef LCD_DMA
+  if(!lcdInit()) Serial.println("LCD DMA init failed, using TFT_eSPI");
+#endif
+}
+
+//
+// Send a command with no parameters to the display
+//
+void drawDisplayCommand(uint8_t cmd)
+{
+#ifdef LCD_DMA
+  if(lcdIO)
+  {
+    esp_lcd_panel_io_tx_param(lcdIO, cmd, 0, 0);
+    return;
+  }
+#endif
+  tft.writecommand(cmd);
+}
+
+//
+// Push rectangle from the sprite to the display
+//
+static void pushRect(const uint16_t *img, int x, int y, int w, int h)
+{
+#ifdef LCD_DMA
+  if(lcdIO)
+  {
+    // Rectangles are never larger than a row of tiles
+    lcdPushRect(img, x, y, w, h);
+    return;
+  }
+#endif
+  spr.pushSprite(x, y, x, y, w, h);
+}
+
+static void pushFull(const uint16_t *img)
+{
+#ifdef LCD_DMA
+  if(lcdIO)
+  {
+    for(int ty=0 ; ty<TILES_Y ; ty++)
+      lcdPushRect(img, 0, ty * TILE_H, 320, TILE_H);
+    return;
+  }
+#endif
+  spr.pushSprite(0, 0);
+}
+
+static uint32_t hashTile(const uint16_t *img, int tx, int ty)
+{
+  const uint16_t *p = img + ty * TILE_H * 320 + tx * TILE_W;
+  uint32_t h = 2166136261UL;
+
+  // FNV-1a over pairs of pixels
+  for(int y=0 ; y<TILE_H ; y++, p+=320)
+  {
+    const uint32_t *q = (const uint32_t *)p;
+    for(int x=0 ; x<TILE_W/2 ; x++) h = (h ^ q[x]) * 16777619UL;
+  }
+
+  return(h);
+}
+
+//
+// Push changed parts of the sprite to the display
+//
+void drawPushSprite()
+{
+  const uint16_t *img = (const uint16_t *)spr.getPointer();
+  uint32_t dirty[TILES_Y] = { 0 };
+  int count = 0;
+
+  // No tile hashes without sprite buffer
+  if(!img)
+  {
+    spr.pushSprite(0, 0);
+    return;
+  }
+
+  // Find tiles that have changed
+  for(int ty=0 ; ty<TILES_Y ; ty++)
+    for(int tx=0 ; tx<TILES_X ; tx++)
+    {
+      uint32_t h = hashTile(img, tx, ty);
+      if(!tilesValid || h!=tileHash[ty][tx])
+      {
+        tileHash[ty][tx] = h;
+        dirty[ty] |= 1 << tx;
+        count++;
+      }
+    }
+
+  // Let screenshots and screen mirroring have this frame
+  captureUpdate(img, dirty);
+
+  // Pushing the whole sprite at once is cheaper if most of it changed
+  if(count > TILES_FULL)
+  {
+    pushFull(img);
+    tilesValid = true;
+    return;
+  }
+
+  // Push runs of adjacent changed tiles
+  for(int ty=0 ; ty<TILES_Y && count ; ty++)
+    for(int tx=0, start=-1 ; tx<=TILES_X ; tx++)
+    {
+      bool d = tx<TILES_X && (dirty[ty] & (1 << tx));
+      if(d && start<0) start = tx;
+      else if(!d && start>=0)
+      {
+        pushRect(img, start * TILE_W, ty * TILE_H, (tx - start) * TILE_W, TILE_H);
+        start = -1;
+      }
+    }
+
+  tilesValid = true;
+}
+
 //
 // Draw preferences write indicator
 //
@@ -107,7 +333,7 @@ void drawMessage(const char *msg)
   if(sleepOn()) return;
 
   drawZoomedMenu(msg, true);
-  spr.pushSprite(0, 0);
+  drawPushSprite();
 }
 
 //
@@ -153,14 +379,12 @@ void drawRadioText(int y, int ymax)
   const char *rt = getRadioText();
 
   // Draw potentially multi-line radio text
-  spr.setTextDatum(TC_DATUM);
-  spr.setTextColor(TH.rds_text);
   for(; *rt && (y<ymax) ; y+=17, rt+=strlen(rt)+1)
-    spr.drawString(rt, 160, y, 2);
+    textCacheDraw(rt, 160, y, 2, TC_DATUM, TH.rds_text);
 
   // Show program info if we have it and there is enough space
   if((y<ymax) && *getProgramInfo())
-    spr.drawString(getProgramInfo(), 160, y, 2);
+    textCacheDraw(getProgramInfo(), 160, y, 2, TC_DATUM, TH.rds_text);
 }
 
 //
@@ -216,8 +440,7 @@ void drawFrequency(uint32_t freq, int x, int y, int ux, int uy, uint8_t hl)
     freqTextColor = infoPanelChangeMode ? 0x07E0 : 0x07FF;  // Green or Cyan
   }
 
-  spr.setTextDatum(MR_DATUM);
-  spr.setTextColor(freqTextColor);
+  char text[32];
 
   if(currentMode==FM)
   {
@@ -225,7 +448,8 @@ void drawFrequency(uint32_t freq, int x, int y, int ux, int uy, uint8_t hl)
     li = hl<ITEM_COUNT(hlDigitsFM)? &hlDigitsFM[hl] : 0;
 
     // FM frequency
-    spr.drawFloat(freq/100.00, 2, x, y, 7);
+    sprintf(text, "%lu.%2.2lu", freq / 100, freq % 100);
+    textCacheDrawGlyphs(text, x, y, 7, MR_DATUM, freqTextColor);
     spr.setTextDatum(ML_DATUM);
     spr.setTextColor(freqTextColor != TH.freq_text ? freqTextColor : TH.funit_text);
     spr.drawString("MHz", ux, uy);
@@ -238,23 +462,22 @@ void drawFrequency(uint32_t freq, int x, int y, int ux, int uy, uint8_t hl)
     if(isSSB())
     {
       // SSB frequency
-      char text[32];
       freq = freq * 1000 + currentBFO;
       sprintf(text, "%3.3lu", freq / 1000);
-      spr.drawString(text, x, y, 7);
-      spr.setTextDatum(ML_DATUM);
+      textCacheDrawGlyphs(text, x, y, 7, MR_DATUM, freqTextColor);
       sprintf(text, ".%3.3lu", freq % 1000);
-      spr.drawString(text, 4+x, 17+y, 4);
+      textCacheDrawGlyphs(text, 4+x, 17+y, 4, ML_DATUM, freqTextColor);
     }
     else
     {
       // AM frequency
-      spr.drawNumber(freq, x, y, 7);
-      spr.setTextDatum(ML_DATUM);
-      spr.drawString(".000", 4+x, 17+y, 4);
+      sprintf(text, "%lu", freq);
+      textCacheDrawGlyphs(text, x, y, 7, MR_DATUM, freqTextColor);
+      textCacheDraw(".000", 4+x, 17+y, 4, ML_DATUM, freqTextColor);
     }
 
     // SSB/AM frequencies are measured in kHz
+    spr.setTextDatum(ML_DATUM);
     spr.setTextColor(freqTextColor != TH.freq_text ? freqTextColor : TH.funit_text);
     spr.drawString("kHz", ux, uy);
   }
@@ -369,9 +592,7 @@ void drawStereoIndicator(int x, int y, bool stereo)
 //
 void drawStationName(const char *name, int x, int y)
 {
-  spr.setTextDatum(TC_DATUM);
-  spr.setTextColor(TH.rds_text);
-  spr.drawString(name, x, y, 4);
+  textCacheDraw(name, x, y, 4, TC_DATUM, TH.rds_text);
 }
 
 //
@@ -379,74 +600,349 @@ void drawStationName(const char *name, int x, int y)
 //
 void drawLongStationName(const char *name, int x, int y)
 {
-  int width = spr.textWidth(name, 2);
-  spr.setTextColor(TH.rds_text);
+  int width = textCacheWidth(name, 2, TH.rds_text);
 
   if((x + width) >= 320)
+    textCacheDraw(name, x, y, 2, TL_DATUM, TH.rds_text);
+  else if(width <= 60)
+    textCacheDraw(name, x + (320 - x) / 3, y, 2, TC_DATUM, TH.rds_text);
+  else
+    textCacheDraw(name, x + (320 - x + width) / 4, y, 2, TC_DATUM, TH.rds_text);
+}
+
+//
+// Scan spectrum
+//
+// Scan points are mapped to individual pixel columns. Zoom level 0
+// matches the frequency scale (8 pixels per scale tick), and every
+// further level halves the resolution until the whole scan fits on
+// screen. When a column covers several scan points, their minimum and
+// maximum are drawn as a vertical bar, so narrow peaks never get lost.
+// When a scan point covers several columns, values are interpolated.
+// The strongest RSSI seen in each column is held until the view moves.
+//
+// Columns are kept as ready to draw Y offsets, computed from the scan
+// data only when the data or the view change. The dotted grid rows are
+// prerendered into line buffers and copied into the sprite.
+//
+#define GRAPH_WIDTH    320              // Graph width (pixels)
+#define GRAPH_HEIGHT   40               // Graph height (pixels)
+#define GRAPH_BOTTOM   169              // Graph bottom line
+#define GRAPH_CENTER   160              // Pointer position at zoom level 0
+#define GRAPH_UPP      10               // Column width at zoom level 0 (1/8 units)
+#define GRAPH_GRID     40               // Grid line spacing (columns)
+#define GRAPH_ZOOMS    8                // Maximum zoom level
+
+typedef struct
+{
+  uint32_t version;                     // Scan data version
+  uint32_t epoch;                       // Scan data epoch
+  int32_t  left;                        // Leftmost column frequency (1/8 units)
+  uint32_t upp;                         // Column width (1/8 units)
+  uint8_t  band;                        // Band index
+  bool     valid;                       // TRUE: cache is valid
+  uint16_t start, end, step;            // Scan extent columns were built from
+  uint8_t  minRSSI, maxRSSI;            // Ranges columns were normalized with
+  uint8_t  minSNR, maxSNR;
+  bool     has[GRAPH_WIDTH];            // TRUE: column has scan data
+  uint8_t  rawRSSI1[GRAPH_WIDTH];       // Raw ranges or interpolation endpoints
+  uint8_t  rawRSSI2[GRAPH_WIDTH];
+  uint8_t  rawSNR1[GRAPH_WIDTH];
+  uint8_t  rawSNR2[GRAPH_WIDTH];
+  uint16_t frac[GRAPH_WIDTH];           // Interpolation position (1/65536 units)
+  uint8_t  loRSSI[GRAPH_WIDTH];         // Normalized ranges (pixels)
+  uint8_t  hiRSSI[GRAPH_WIDTH];
+  uint8_t  loSNR[GRAPH_WIDTH];
+  uint8_t  hiSNR[GRAPH_WIDTH];
+  uint8_t  rawPeak[GRAPH_WIDTH];        // Held RSSI peaks (raw, 0 = none)
+  uint8_t  yPeak[GRAPH_WIDTH];          // Held RSSI peaks (pixels)
+} GraphCache;
+
+typedef struct
+{
+  int32_t  left;                        // Leftmost column frequency (1/8 units)
+  uint32_t upp;                         // Column width (1/8 units)
+  uint8_t  band;                        // Band index
+  uint16_t color;                       // Grid color
+  uint16_t bg;                          // Background color
+  bool     valid;                       // TRUE: lines are valid
+  uint16_t dots[GRAPH_WIDTH];           // Row with grid dots only
+  uint16_t line[GRAPH_WIDTH];           // Row with grid line and dots
+} GraphGrid;
+
+static GraphCache graph;
+static GraphGrid grid;
+
+static inline uint16_t swapColor(uint16_t c) { return((c >> 8) | (c << 8)); }
+
+static inline uint8_t graphScale(uint8_t v, uint8_t vMin, uint8_t vMax)
+{
+  // Same as the float normalization in scanGetRSSI()/scanGetSNR()
+  if(vMax <= vMin) return(GRAPH_HEIGHT / 2);
+  v = v < vMin? vMin : v > vMax? vMax : v;
+  return(GRAPH_HEIGHT * (v - vMin) / (vMax - vMin + 1));
+}
+
+//
+// Get maximum zoom level for the current scan data
+//
+uint8_t drawScanMaxZoom()
+{
+  uint16_t start, end;
+  uint8_t zoom = 0;
+
+  if(!scanGetExtent(&start, &end)) return(0);
+
+  // Stop zooming out once the whole scan fits on screen
+  while(zoom<GRAPH_ZOOMS && GRAPH_WIDTH * (GRAPH_UPP << zoom) < (uint32_t)(end - start) * 8)
+    zoom++;
+
+  return(zoom);
+}
+
+//
+// Compute leftmost column frequency and column width for given zoom
+//
+static void graphView(uint32_t freq, uint8_t zoom, int32_t *left, uint32_t *upp)
+{
+  uint16_t start, end;
+
+  *upp  = GRAPH_UPP << zoom;
+  *left = (int32_t)freq * 8 - GRAPH_CENTER * (int32_t)*upp;
+
+  // When zoomed out, keep as much scan data on screen as possible
+  if(zoom && scanGetExtent(&start, &end))
   {
-    spr.setTextDatum(TL_DATUM);
-    spr.drawString(name, x, y, 2);
+    int32_t width = GRAPH_WIDTH * *upp;
+
+    if(width >= (end - start) * 8)
+      *left = (start + end) * 4 - width / 2;
+    else if(*left < start * 8)
+      *left = start * 8;
+    else if(*left + width > end * 8)
+      *left = end * 8 - width;
   }
-  else if(width <= 60)
+}
+
+//
+// Fetch raw scan values for a graph column
+//
+static void graphFetch(int x)
+{
+  int32_t lo = graph.left + x * (int32_t)graph.upp;
+  uint32_t span = graph.step * 8;
+  uint16_t start = graph.start;
+  uint8_t r1, r2, s1, s2;
+
+  graph.has[x] = false;
+  if(!graph.step || lo < 0 || lo < start * 8 - (int32_t)graph.upp || lo >= graph.end * 8) return;
+
+  if(span <= graph.upp)
   {
-    spr.setTextDatum(TC_DATUM);
-    spr.drawString(name, x + (320 - x) / 3, y, 2);
+    // Column covers one or more scan points: take their range
+    if(!scanGetSpan((lo + 7) / 8, (lo + graph.upp + 7) / 8, &r1, &r2, &s1, &s2)) return;
+    graph.frac[x] = 0;
   }
   else
   {
-    spr.setTextDatum(TC_DATUM);
-    spr.drawString(name, x + (320 - x + width) / 4, y, 2);
+    // Scan point covers several columns: interpolate between points
+    if(lo < start * 8) return;
+    uint32_t d = lo - start * 8;
+    uint16_t f = start + d / span * graph.step;
+
+    if(!scanGetPointAt(f, &r1, &s1)) return;
+    if(!scanGetPointAt(f + graph.step, &r2, &s2)) { r2 = r1; s2 = s1; }
+    graph.frac[x] = (d % span) * 65536 / span;
   }
+
+  graph.has[x]      = true;
+  graph.rawRSSI1[x] = r1;
+  graph.rawRSSI2[x] = r2;
+  graph.rawSNR1[x]  = s1;
+  graph.rawSNR2[x]  = s2;
+  graph.rawPeak[x]  = max(graph.rawPeak[x], max(r1, r2));
 }
 
 //
-// Draw scan graphs
+// Convert raw values of a graph column to pixels
 //
-void drawScanGraphs(uint32_t freq)
+static void graphNormalize(int x)
 {
-  // Scale offset
-  int16_t offset = (freq % 10) / 10.0 * 8;
+  if(!graph.has[x]) return;
 
-  // Start drawing frequencies from the left
-  freq = freq / 10 - 20;
+  int r1 = graphScale(graph.rawRSSI1[x], graph.minRSSI, graph.maxRSSI);
+  int r2 = graphScale(graph.rawRSSI2[x], graph.minRSSI, graph.maxRSSI);
+  int s1 = graphScale(graph.rawSNR1[x], graph.minSNR, graph.maxSNR);
+  int s2 = graphScale(graph.rawSNR2[x], graph.minSNR, graph.maxSNR);
+
+  if(graph.step * 8 <= graph.upp)
+  {
+    graph.loRSSI[x] = r1;
+    graph.hiRSSI[x] = r2;
+    graph.loSNR[x]  = s1;
+    graph.hiSNR[x]  = s2;
+  }
+  else
+  {
+    graph.loRSSI[x] = graph.hiRSSI[x] = r1 + (r2 - r1) * (int32_t)graph.frac[x] / 65536;
+    graph.loSNR[x]  = graph.hiSNR[x]  = s1 + (s2 - s1) * (int32_t)graph.frac[x] / 65536;
+  }
+
+  graph.yPeak[x] = graphScale(graph.rawPeak[x], graph.minRSSI, graph.maxRSSI);
+}
+
+static void graphUpdate(int32_t left, uint32_t upp)
+{
+  uint8_t minRSSI, maxRSSI, minSNR, maxSNR;
+  uint16_t start = 0, end = 0;
+  uint32_t version = scanGetVersion();
+  uint32_t epoch = scanGetEpoch();
+  bool view = graph.valid && graph.left==left && graph.upp==upp && graph.band==bandIdx;
+
+  if(view && graph.version==version) return;
+
+  scanGetRange(&minRSSI, &maxRSSI, &minSNR, &maxSNR);
+  uint16_t step = scanGetExtent(&start, &end);
+  int x1 = 0, x2 = GRAPH_WIDTH;
+
+  if(view && graph.epoch==epoch && step && step==graph.step && start==graph.start && end>=graph.end)
+  {
+    // Points have only been appended: refetch columns from the last
+    // old point (which new columns interpolate from) to the new end
+    int32_t from = (graph.end - step) * 8 - (int32_t)upp - left;
+    int32_t to   = end * 8 - left;
+    x1 = from <= 0? 0 : from / (int32_t)upp;
+    x2 = to < 0? 0 : to / (int32_t)upp + 1;
+    x1 = x1 > GRAPH_WIDTH? GRAPH_WIDTH : x1;
+    x2 = x2 > GRAPH_WIDTH? GRAPH_WIDTH : x2;
+  }
+  else if(!view)
+  {
+    // Peaks are only held while the view stays the same
+    memset(graph.rawPeak, 0, sizeof(graph.rawPeak));
+  }
+
+  graph.left  = left;
+  graph.upp   = upp;
+  graph.band  = bandIdx;
+  graph.start = start;
+  graph.end   = end;
+  graph.step  = step;
+
+  for(int x=x1 ; x<x2 ; x++) graphFetch(x);
+
+  // Only rescale all columns if the ranges have changed
+  if(minRSSI!=graph.minRSSI || maxRSSI!=graph.maxRSSI || minSNR!=graph.minSNR || maxSNR!=graph.maxSNR)
+  {
+    x1 = 0;
+    x2 = GRAPH_WIDTH;
+  }
+
+  graph.minRSSI = minRSSI;
+  graph.maxRSSI = maxRSSI;
+  graph.minSNR  = minSNR;
+  graph.maxSNR  = maxSNR;
+
+  for(int x=x1 ; x<x2 ; x++) graphNormalize(x);
+
+  graph.version = version;
+  graph.epoch   = epoch;
+  graph.valid   = true;
+}
+
+static void gridUpdate(int32_t left, uint32_t upp)
+{
+  if(grid.valid && grid.left==left && grid.upp==upp && grid.band==bandIdx && grid.color==TH.scan_grid && grid.bg==TH.bg)
+    return;
+
+  uint16_t color = swapColor(TH.scan_grid);
+  uint16_t bg = swapColor(TH.bg);
+
+  for(int x=0 ; x<GRAPH_WIDTH ; x++) grid.dots[x] = grid.line[x] = bg;
 
   // Get band edges
   const Band *band = getCurrentBand();
-  uint32_t minFreq = band->minimumFreq / 10;
-  uint32_t maxFreq = band->maximumFreq / 10;
+  int32_t minFreq = band->minimumFreq * 8;
+  int32_t maxFreq = band->maximumFreq * 8;
+  int32_t gridStep = GRAPH_GRID * upp;
 
-  for(int i=0 ; i<41 ; i++, freq++)
+  for(int x=0 ; x<GRAPH_WIDTH ; x++)
   {
-    int16_t x = i * 8 - offset;
+    int32_t lo = left + x * (int32_t)upp;
+    if(lo < minFreq || lo >= maxFreq) continue;
 
-    if(freq >= minFreq && freq <= maxFreq)
-    {
-      if((freq % 5) == 0) {
-        for(int y=0; y<42; y+=2) {
-          spr.drawPixel(x, 169-y, TH.scan_grid);
-        }
-      }
+    // Vertical dotted lines at round frequencies
+    if((lo + (int32_t)upp - 1) / gridStep * gridStep >= lo)
+      grid.dots[x] = grid.line[x] = color;
 
-      if((freq+1) <= maxFreq) {
-        for(int xd=x; xd<(x+8); xd+=2) {
-          spr.drawPixel(xd, 169-40, TH.scan_grid);
-          spr.drawPixel(xd, 169-30, TH.scan_grid);
-          spr.drawPixel(xd, 169-20, TH.scan_grid);
-          spr.drawPixel(xd, 169-10, TH.scan_grid);
-          spr.drawPixel(xd, 169-0, TH.scan_grid);
-        }
-        int snr1 = 40 * scanGetSNR(freq * 10);
-        int snr2 = 40 * scanGetSNR((freq+1) * 10);
-        spr.drawLine(x, 169-snr1, x+8, 169-snr2, TH.scan_snr);
-        int rssi1 = 40 * scanGetRSSI(freq * 10);
-        int rssi2 = 40 * scanGetRSSI((freq+1) * 10);
-        spr.drawLine(x, 169-rssi1, x+8, 169-rssi2, TH.scan_rssi);
-      }
+    // Horizontal dotted lines, moving with frequency
+    if(!((lo / upp) & 1)) grid.line[x] = color;
+  }
+
+  grid.left  = left;
+  grid.upp   = upp;
+  grid.band  = bandIdx;
+  grid.color = TH.scan_grid;
+  grid.bg    = TH.bg;
+  grid.valid = true;
+}
+
+static inline void graphColumn(int x, uint8_t lo, uint8_t hi, uint8_t prevLo, uint8_t prevHi, uint16_t color)
+{
+  // Extend the bar to reach the previous column
+  if(lo > prevHi) lo = prevHi;
+  if(hi < prevLo) hi = prevLo;
+  spr.drawFastVLine(x, GRAPH_BOTTOM - hi, hi - lo + 1, color);
+}
+
+//
+// Draw scan graphs
+//
+void drawScanGraphs(uint32_t freq)
+{
+  uint16_t *img = (uint16_t *)spr.getPointer();
+  uint8_t zoom = min(scanZoomIdx, drawScanMaxZoom());
+  int32_t left;
+  uint32_t upp;
+
+  graphView(freq, zoom, &left, &upp);
+
+  // Prerendered grid rows: lines every 10 pixels, dots every 2 pixels
+  gridUpdate(left, upp);
+  if(img)
+    for(int y=0 ; y<=GRAPH_HEIGHT ; y+=2)
+      memcpy(img + (GRAPH_BOTTOM - y) * GRAPH_WIDTH, y % 10? grid.dots : grid.line, sizeof(grid.line));
+
+  // Cached graph columns
+  graphUpdate(left, upp);
+
+  for(int x=0 ; x<GRAPH_WIDTH ; x++)
+  {
+    if(!graph.has[x]) continue;
+
+    if(x && graph.has[x-1])
+    {
+      graphColumn(x, graph.loSNR[x], graph.hiSNR[x], graph.loSNR[x-1], graph.hiSNR[x-1], TH.scan_snr);
+      graphColumn(x, graph.loRSSI[x], graph.hiRSSI[x], graph.loRSSI[x-1], graph.hiRSSI[x-1], TH.scan_rssi);
+    }
+    else
+    {
+      graphColumn(x, graph.loSNR[x], graph.hiSNR[x], graph.hiSNR[x], graph.loSNR[x], TH.scan_snr);
+      graphColumn(x, graph.loRSSI[x], graph.hiRSSI[x], graph.hiRSSI[x], graph.loRSSI[x], TH.scan_rssi);
     }
+
+    // Held peak above the current data
+    if(graph.yPeak[x] > graph.hiRSSI[x])
+      spr.drawPixel(x, GRAPH_BOTTOM - graph.yPeak[x], TH.scan_rssi);
   }
+
   // Scale pointer
-  spr.fillTriangle(156, 125, 160, 130, 164, 125, TH.scale_pointer);
-  spr.drawLine(160, 130, 160, 169, TH.scale_pointer);
+  int16_t x = ((int32_t)freq * 8 - left) / (int32_t)upp;
+  if(x >= 0 && x < GRAPH_WIDTH)
+  {
+    spr.fillTriangle(x - 4, 125, x, 130, x + 4, 125, TH.scale_pointer);
+    spr.drawLine(x, 130, x, 169, TH.scale_pointer);
+  }
 }
 
 //
@@ -476,5 +972,5 @@ void drawScreen(const char *statusLine1, const char *statusLine2)
       break;
   }
 
-  spr.pushSprite(0, 0);
+  drawPushSprite();
 }
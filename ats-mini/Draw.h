@@ -32,10 +32,20 @@
 #define BLE_OFFSET_X   104    // BLE x offset
 #define BLE_OFFSET_Y     0    // BLE y offset
 
+// Dirty region tiles
+#define TILE_W          32    // Tile width (must be even)
+#define TILE_H          10    // Tile height
+#define TILES_X  (320 / TILE_W) // Tiles per row
+#define TILES_Y  (170 / TILE_H) // Tile rows
+
 void drawMessage(const char *msg);
 void drawZoomedMenu(const char *text, bool force = false);
 void drawScanGraphs(uint32_t freq);
+uint8_t drawScanMaxZoom();
 void drawScreen(const char *statusLine1 = 0, const char *statusLine2 = 0);
+void drawPushSprite();
+void drawInit();
+void drawDisplayCommand(uint8_t cmd);
 
 void drawWiFiIndicator(int x, int y);
 void drawSaveIndicator(int x, int y);
@@ -50,6 +60,10 @@ bool drawWiFiStatus(const char *statusLine1, const char *statusLine2, int x, int
 void drawRadioText(int y, int ymax);
 void drawScale(uint32_t freq);
 
+int textCacheWidth(const char *text, uint8_t font, uint16_t color);
+int textCacheDraw(const char *text, int x, int y, uint8_t font, uint8_t datum, uint16_t color);
+int textCacheDrawGlyphs(const char *text, int x, int y, uint8_t font, uint8_t datum, uint16_t color);
+
 void drawLayoutDefault(const char *statusLine1, const char *statusLine2);
 void drawLayoutSmeter(const char *statusLine1, const char *statusLine2);
 
@@ -0,0 +1,234 @@
+#include "Common.h"
+#include "Encoder.h"
+#include "Rotary.h"
+
+#ifdef ENCODER_PCNT
+#include <driver/pulse_cnt.h>
+#endif
+
+//
+// Rotary encoder
+//
+// By default, the encoder is decoded in software on every pin change
+// interrupt. The ISR only timestamps steps and queues them in a ring,
+// everything else is done by consumeEncoderCounts() in the main loop.
+//
+// With ENCODER_PCNT, the ESP32-S3 pulse counter decodes the quadrature
+// signal in hardware, with its glitch filter taking care of contact
+// bounce, so the encoder causes no interrupts at all. The main loop
+// reads count deltas, spreading steps evenly over the time since the
+// last read for acceleration purposes.
+//
+
+#define ENCODER_GLITCH_NS 1000   // PCNT glitch filter (ns)
+#define ENCODER_LIMIT     30000  // PCNT counter wraps to 0 at +/-ENCODER_LIMIT
+
+#ifdef HALF_STEP
+#define ENCODER_COUNTS    2      // PCNT counts per step
+#else
+#define ENCODER_COUNTS    4      // PCNT counts per step
+#endif
+
+static EncoderAccel encoderAccel;
+
+static inline uint32_t encoderPack(int16_t count, int16_t accel)
+{
+  return(((uint32_t)accel << 16) | ((uint16_t)count & 0xFFFF));
+}
+
+#ifndef ENCODER_PCNT
+
+// Encoder steps, written by rotaryEncoder(), read by consumeEncoderCounts()
+typedef struct
+{
+  uint32_t time;        // Step time (ms)
+  int8_t   dir;         // Step direction (1 or -1)
+} EncoderEvent;
+
+static Rotary encoder = Rotary(ENCODER_PIN_B, ENCODER_PIN_A);
+static volatile EncoderEvent encoderRing[ENCODER_RING];
+static volatile uint8_t encoderHead = 0;
+static volatile uint8_t encoderTail = 0;
+
+//
+// Reads encoder via interrupt
+// Uses Rotary.h and Rotary.cpp implementation to process encoder via
+// interrupt. If you do not add ICACHE_RAM_ATTR declaration, the system
+// will reboot during attachInterrupt call. The ICACHE_RAM_ATTR macro
+// places this function into RAM.
+//
+// This is the only writer of encoderHead, and the main loop is the only
+// writer of encoderTail.
+//
+static ICACHE_RAM_ATTR void rotaryEncoder()
+{
+  // Rotary encoder events
+  uint8_t encoderStatus = encoder.process();
+  if(encoderStatus)
+  {
+    uint8_t head = encoderHead;
+
+    // Only drop steps if the main loop is ENCODER_RING steps behind
+    if((uint8_t)(head - encoderTail) < ENCODER_RING)
+    {
+      encoderRing[head & (ENCODER_RING - 1)].time = millis();
+      encoderRing[head & (ENCODER_RING - 1)].dir  = encoderStatus==DIR_CW? 1 : -1;
+      encoderHead = head + 1;
+    }
+
+    // Reset the seek flag (but not during scans - only button click should stop scan)
+    if(!scanIsRadioRunning()) seekStop = true;
+  }
+}
+
+void encoderInit()
+{
+  encoderAccelReset(&encoderAccel);
+  attachInterrupt(digitalPinToInterrupt(ENCODER_PIN_A), rotaryEncoder, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(ENCODER_PIN_B), rotaryEncoder, CHANGE);
+}
+
+//
+// Take all queued encoder steps, returns accelerated count in the
+// upper 16 bits and plain count in the lower 16 bits
+//
+uint32_t consumeEncoderCounts()
+{
+  int16_t encCount = 0, encCountAccel = 0;
+  uint8_t head = encoderHead;
+
+  for(uint8_t tail = encoderTail ; tail != head ; tail++)
+  {
+    const volatile EncoderEvent *ev = &encoderRing[tail & (ENCODER_RING - 1)];
+    encCount += ev->dir;
+    encCountAccel += encoderAccelerate(&encoderAccel, ev->dir, ev->time);
+  }
+
+  encoderTail = head;
+  return(encoderPack(encCount, encCountAccel));
+}
+
+//
+// Returns true if encoder steps are waiting
+//
+bool encoderPending()
+{
+  return(encoderHead != encoderTail);
+}
+
+//
+// The ISR sets seekStop itself
+//
+void encoderPoll()
+{
+}
+
+#else // ENCODER_PCNT
+
+static pcnt_unit_handle_t encoderUnit = 0;
+static int encoderCount = 0;      // Last consumed count
+static uint32_t encoderTime = 0;  // Last consume time
+
+void encoderInit()
+{
+  pcnt_unit_config_t unitConfig = {};
+  unitConfig.low_limit  = -ENCODER_LIMIT;
+  unitConfig.high_limit = ENCODER_LIMIT;
+
+  pcnt_glitch_filter_config_t filterConfig = {};
+  filterConfig.max_glitch_ns = ENCODER_GLITCH_NS;
+
+  pcnt_chan_config_t chanAConfig = {};
+  chanAConfig.edge_gpio_num  = ENCODER_PIN_A;
+  chanAConfig.level_gpio_num = ENCODER_PIN_B;
+
+  pcnt_chan_config_t chanBConfig = {};
+  chanBConfig.edge_gpio_num  = ENCODER_PIN_B;
+  chanBConfig.level_gpio_num = ENCODER_PIN_A;
+
+  pcnt_channel_handle_t chanA, chanB;
+
+  pinMode(ENCODER_PIN_A, INPUT_PULLUP);
+  pinMode(ENCODER_PIN_B, INPUT_PULLUP);
+  encoderAccelReset(&encoderAccel);
+
+  if(pcnt_new_unit(&unitConfig, &encoderUnit) != ESP_OK)
+  {
+    encoderUnit = 0;
+    return;
+  }
+
+  pcnt_unit_set_glitch_filter(encoderUnit, &filterConfig);
+  pcnt_new_channel(encoderUnit, &chanAConfig, &chanA);
+  pcnt_new_channel(encoderUnit, &chanBConfig, &chanB);
+
+  // Quadrature decoding, clockwise counts up
+  pcnt_channel_set_edge_action(chanA, PCNT_CHANNEL_EDGE_ACTION_DECREASE, PCNT_CHANNEL_EDGE_ACTION_INCREASE);
+  pcnt_channel_set_level_action(chanA, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE);
+  pcnt_channel_set_edge_action(chanB, PCNT_CHANNEL_EDGE_ACTION_INCREASE, PCNT_CHANNEL_EDGE_ACTION_DECREASE);
+  pcnt_channel_set_level_action(chanB, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE);
+
+  pcnt_unit_enable(encoderUnit);
+  pcnt_unit_clear_count(encoderUnit);
+  pcnt_unit_start(encoderUnit);
+  encoderTime = millis();
+}
+
+//
+// Get counts since given count, accounting for counter wrapping
+//
+static int encoderDelta(int since, int *count)
+{
+  if(!encoderUnit || pcnt_unit_get_count(encoderUnit, count) != ESP_OK)
+  {
+    *count = since;
+    return(0);
+  }
+
+  int delta = *count - since;
+  if(delta > ENCODER_LIMIT / 2) delta -= ENCODER_LIMIT;
+  else if(delta < -ENCODER_LIMIT / 2) delta += ENCODER_LIMIT;
+  return(delta);
+}
+
+//
+// Take all encoder steps since the last call, returns accelerated count
+// in the upper 16 bits and plain count in the lower 16 bits
+//
+uint32_t consumeEncoderCounts()
+{
+  int count;
+  int steps = encoderDelta(encoderCount, &count) / ENCODER_COUNTS;
+  uint32_t now = millis();
+  int16_t encCountAccel = 0;
+
+  // Keep partial steps for the next time
+  encoderCount = (encoderCount + steps * ENCODER_COUNTS) % ENCODER_LIMIT;
+  int n = abs(steps);
+
+  // Spread steps evenly over the time since the last call
+  for(int j=1 ; j<=n ; j++)
+    encCountAccel += encoderAccelerate(&encoderAccel, steps>0? 1 : -1, encoderTime + (now - encoderTime) * j / n);
+
+  encoderTime = now;
+  return(encoderPack(steps, encCountAccel));
+}
+
+//
+// Returns true if encoder steps are waiting
+//
+bool encoderPending()
+{
+  int count;
+  return(abs(encoderDelta(encoderCount, &count)) >= ENCODER_COUNTS);
+}
+
+//
+// Set seekStop when the encoder moves, called while seeking or scanning
+//
+void encoderPoll()
+{
+  if(encoderPending() && !scanIsRadioRunning()) seekStop = true;
+}
+
+#endif // ENCODER_PCNT
@@ -0,0 +1,27 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include <stdint.h>
+
+#define ENCODER_RING     64   // Maximum steps waiting for the main loop (power of two)
+
+// Acceleration state, see encoderAccelerate()
+typedef struct
+{
+  uint32_t time;              // Last step time (ms)
+  uint32_t speed;             // Average time between steps (ms)
+  uint16_t factor;            // Current acceleration factor
+  int8_t   dir;               // Last step direction
+} EncoderAccel;
+
+// EncoderAccel.cpp (does not depend on the hardware)
+void encoderAccelReset(EncoderAccel *acc);
+int16_t encoderAccelerate(EncoderAccel *acc, int8_t dir, uint32_t time);
+
+// Encoder input
+void encoderInit();
+uint32_t consumeEncoderCounts();
+bool encoderPending();
+void encoderPoll();
+
+#endif // ENCODER_H
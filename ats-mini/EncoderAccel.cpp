@@ -0,0 +1,56 @@
+#include <stdint.h>
+#include "Encoder.h"
+
+//
+// Rotary encoder acceleration
+//
+// Does not depend on the hardware or the Arduino core, so it can be
+// built and tested on the host (see test/EncoderTest.cpp).
+//
+
+//
+// Reset acceleration state
+//
+void encoderAccelReset(EncoderAccel *acc)
+{
+  acc->time   = 0;
+  acc->speed  = 350;
+  acc->factor = 1;
+  acc->dir    = 0;
+}
+
+//
+// Compute accelerated step from the time between encoder steps
+//
+int16_t encoderAccelerate(EncoderAccel *acc, int8_t dir, uint32_t time)
+{
+  const uint32_t speedThresholds[] = {350, 60, 45, 35, 25}; // ms between clicks
+  const uint16_t accelFactors[] =      {1,  2,  4,  8, 16}; // corresponding multipliers
+
+  acc->speed = ((time - acc->time) * 7 + acc->speed * 3) / 10;
+
+  // Reset acceleration on timeout or direction change
+  if(acc->speed > speedThresholds[0] || acc->dir != dir)
+  {
+    acc->speed  = speedThresholds[0];
+    acc->factor = accelFactors[0];
+  }
+  else
+  {
+    // Lookup acceleration factor
+    for(int8_t i = sizeof(speedThresholds) / sizeof(speedThresholds[0]) - 1; i >= 0; i--)
+    {
+      if(acc->speed <= speedThresholds[i] && acc->factor < accelFactors[i])
+      {
+        acc->factor = accelFactors[i];
+        break;
+      }
+    }
+  }
+
+  acc->time = time;
+  acc->dir  = dir;
+
+  // Apply acceleration with direction
+  return(dir * acc->factor);
+}
@@ -80,10 +80,11 @@ Band *getCurrentBand() { return(&bands[bandIdx]); }
 #define MENU_HOME         0
 #define MENU_SEEK         1
 #define MENU_SCAN         2
-#define MENU_MEMORY       3
-#define MENU_AVC          4
-#define MENU_SOFTMUTE     5
-#define MENU_SETTINGS     6
+#define MENU_STATIONS     3
+#define MENU_MEMORY       4
+#define MENU_AVC          5
+#define MENU_SOFTMUTE     6
+#define MENU_SETTINGS     7
 
 int8_t menuIdx = MENU_SEEK;
 
@@ -98,6 +99,7 @@ static const char *menu[] =
   "Home",
   "Seek",
   "Scan",
+  "Stations",
   "Memory",
   "AVC",
   "SoftMute",
@@ -201,6 +203,7 @@ const char *getMenuItemName()
     case CMD_SOFTMUTE:  return "SoftMute";
     case CMD_AVC:       return "AVC";
     case CMD_MEMORY:    return "Memory";
+    case CMD_STATIONS:  return "Stations";
     case CMD_SEEK:      return "Seek";
     case CMD_SCAN:      return "Scan";
     case CMD_SQUELCH:   return "Squelch";
@@ -257,6 +260,8 @@ static const RDSMode rdsMode[] =
   { RDS_PS | RDS_PI | RDS_RT | RDS_PT | RDS_RBDS, "ALL-CT (US)" },
   { RDS_PS | RDS_PI | RDS_RT | RDS_PT | RDS_CT, "ALL (EU)" },
   { RDS_PS | RDS_PI | RDS_RT | RDS_PT | RDS_CT | RDS_RBDS, "ALL (US)" },
+  { RDS_PS | RDS_PI | RDS_RT | RDS_PT | RDS_CT | RDS_AF, "ALL+AF (EU)" },
+  { RDS_PS | RDS_PI | RDS_RT | RDS_PT | RDS_CT | RDS_RBDS | RDS_AF, "ALL+AF (US)" },
 };
 
 uint8_t getRDSMode() { return(rdsMode[rdsModeIdx].mode); }
@@ -325,6 +330,11 @@ uint8_t uiLayoutIdx = 0;
 static const char *uiLayoutDesc[] =
 { "Default", "S-Meter" };
 
+//
+// Scan spectrum zoom (0 = scale resolution, each level halves it)
+//
+uint8_t scanZoomIdx = 0;
+
 //
 // Bluetooth Mode Menu
 //
@@ -851,6 +861,45 @@ static void clickMemory(uint8_t idx, bool shortPress)
   else currentCmd = CMD_NONE;
 }
 
+//
+// Stations Menu
+//
+
+static uint8_t stationIdx = 0;
+
+static void doStations(int16_t enc)
+{
+  const ScanPeak *peaks;
+  uint8_t count = scanGetPeaks(bandIdx, &peaks, 0);
+
+  // Do not retune while scanning
+  if(!count || scanIsRunning() || scanIsRadioRunning()) return;
+
+  stationIdx = clamp_range(min(stationIdx, count - 1), enc, 0, count - 1);
+
+  if(peaks[stationIdx].tune!=currentFrequency && updateFrequency(peaks[stationIdx].tune, false))
+  {
+    clearStationInfo();
+    identifyFrequency(currentFrequency + currentBFO / 1000);
+  }
+}
+
+static void selectStation()
+{
+  // Load this band's scan data, unless scanning
+  if(!scanIsRunning() && !scanIsRadioRunning() && scanHasDataForBand(bandIdx))
+    scanLoadFromBandCache(bandIdx);
+
+  const ScanPeak *peaks;
+  uint8_t count = scanGetPeaks(bandIdx, &peaks, 0);
+
+  // Start with the station closest to the current frequency
+  stationIdx = 0;
+  for(int i=1 ; i<count ; i++)
+    if(abs(peaks[i].tune - currentFrequency) < abs(peaks[stationIdx].tune - currentFrequency))
+      stationIdx = i;
+}
+
 void doStep(int16_t enc)
 {
   uint8_t idx = bands[bandIdx].currentStepIdx;
@@ -917,6 +966,11 @@ void doSquelch(int16_t enc)
   currentSquelch = clamp_range(currentSquelch, enc, 0, 127);
 }
 
+void doScanZoom(int16_t enc)
+{
+  scanZoomIdx = clamp_range(scanZoomIdx, enc, 0, drawScanMaxZoom());
+}
+
 void doSoftMute(int16_t enc)
 {
   // Nothing to do if FM mode
@@ -956,20 +1010,26 @@ void doBandwidth(int16_t enc)
 // Direct parameter setters (for web/serial interface)
 //
 
+// Set band by index, returns band index or -1 if invalid
+int setBandByIndex(int idx)
+{
+  if(idx < 0 || idx >= getTotalBands()) return -1;
+
+  // Save current band settings
+  bands[bandIdx].currentFreq = currentFrequency + currentBFO / 1000;
+  bands[bandIdx].bandMode = currentMode;
+  // Select the new band
+  selectBand(idx);
+  return idx;
+}
+
 // Set band by name, returns band index or -1 if not found
 int setBandByName(const char *name)
 {
   for(int i = 0; i < getTotalBands(); i++)
   {
     if(strcmp(bands[i].bandName, name) == 0)
-    {
-      // Save current band settings
-      bands[bandIdx].currentFreq = currentFrequency + currentBFO / 1000;
-      bands[bandIdx].bandMode = currentMode;
-      // Select the new band
-      selectBand(i);
-      return i;
-    }
+      return setBandByIndex(i);
   }
   return -1;
 }
@@ -1157,6 +1217,11 @@ static void clickMenu(int cmd, bool shortPress)
       if(currentMode!=FM) currentCmd = CMD_AVC;
       break;
 
+    case MENU_STATIONS:
+      currentCmd = CMD_STATIONS;
+      selectStation();
+      break;
+
     case MENU_SCAN:
       // Run a band scan around current frequency with the same
       // step as scale resolution (10kHz for AM, 100kHz for FM)
@@ -1246,6 +1311,7 @@ bool doSideBar(uint16_t cmd, int16_t enc, int16_t enca)
     case CMD_UI:        doUILayout(scrollDirection * enc);break;
     case CMD_RDS:       doRDSMode(scrollDirection * enc);break;
     case CMD_MEMORY:    doMemory(scrollDirection * enca);break;
+    case CMD_STATIONS:  doStations(scrollDirection * enc);break;
     case CMD_SLEEP:     doSleep(enca);break;
     case CMD_SLEEPMODE: doSleepMode(scrollDirection * enc);break;
     case CMD_BLEMODE:   doBleMode(scrollDirection * enc);break;
@@ -1283,6 +1349,7 @@ bool clickHandler(uint16_t cmd, bool shortPress)
     case CMD_MENU:     clickMenu(menuIdx, shortPress);break;
     case CMD_SETTINGS: clickSettings(settingsIdx, shortPress);break;
     case CMD_MEMORY:   clickMemory(memoryIdx, shortPress);break;
+    case CMD_STATIONS: currentCmd = CMD_NONE;break;
     case CMD_WIFIMODE: clickWiFiMode(wifiModeIdx, shortPress);break;
     case CMD_VOLUME:   clickVolume(shortPress);break;
     case CMD_SQUELCH:  clickSquelch(shortPress);break;
@@ -1361,7 +1428,7 @@ static void drawMenu(int x, int y, int sx)
 {
   spr.setTextDatum(MC_DATUM);
 
-  // Smaller menu panel - fits 7 items with fixed positions and moving cursor
+  // Smaller menu panel - fits 8 items with fixed positions and moving cursor
   int count = ITEM_COUNT(menu);
   int menuHeight = 22 + (count * 16) + 8;  // Header + items + padding
   spr.fillSmoothRoundRect(1+x, 1, 76+sx, menuHeight, 4, TH.menu_border);
@@ -1876,6 +1943,45 @@ static void drawMemory(int x, int y, int sx)
   }
 }
 
+static void drawStations(int x, int y, int sx)
+{
+  const ScanPeak *peaks;
+  uint8_t count = scanGetPeaks(bandIdx, &peaks, 0);
+
+  char label_station[16];
+  if(count)
+    sprintf(label_station, "Station %2.2d", stationIdx + 1);
+  else
+    strcpy(label_station, menu[MENU_STATIONS]);
+  drawCommon(label_station, x, y, sx, true);
+
+  for(int i=-2 ; i<3 ; i++)
+  {
+    int j = stationIdx + i;
+    char buf[16];
+    const char *text = buf;
+
+    if(!count && !i)
+      text = "No scan";
+    else if(j<0 || j>=count)
+      continue;
+    else if(currentMode==FM)
+      sprintf(buf, "%3.2f %2u", peaks[j].freq / 100.0, peaks[j].rssi);
+    else
+      sprintf(buf, "%5u %2u", peaks[j].freq, peaks[j].rssi);
+
+    if(i==0) {
+      drawZoomedMenu(text);
+      spr.setTextColor(0x0000, 0x07FF);
+    } else {
+      spr.setTextColor(TH.menu_item);
+    }
+
+    spr.setTextDatum(MC_DATUM);
+    spr.drawString(text, 40+x+(sx/2), 64+y+(i*16), 2);
+  }
+}
+
 static void drawVolume(int x, int y, int sx)
 {
   drawCommon("Volume", x, y, sx);
@@ -2166,6 +2272,7 @@ void drawSideBar(uint16_t cmd, int x, int y, int sx)
     case CMD_BRT:       drawBrt(x, y, sx);       break;
     case CMD_RDS:       drawRDSMode(x, y, sx);   break;
     case CMD_MEMORY:    drawMemory(x, y, sx);    break;
+    case CMD_STATIONS:  drawStations(x, y, sx);  break;
     case CMD_SLEEP:     drawSleep(x, y, sx);     break;
     case CMD_SLEEPMODE: drawSleepMode(x, y, sx); break;
     case CMD_BLEMODE:   drawBleMode(x, y, sx);   break;
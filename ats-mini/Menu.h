@@ -30,7 +30,8 @@
 #define CMD_MEMORY    0x1900 // |
 #define CMD_SEEK      0x1A00 // |
 #define CMD_SCAN      0x1B00 // |
-#define CMD_SQUELCH   0x1C00 //-+
+#define CMD_SQUELCH   0x1C00 // |
+#define CMD_STATIONS  0x1D00 //-+
 #define CMD_SETTINGS  0x2000 //-SETTINGS MODE starts here
 #define CMD_BRT       0x2100 // |
 #define CMD_CAL       0x2200 // |
@@ -130,6 +131,7 @@ bool recallMemorySlot(uint8_t slot);
 int tuneToFrequency(uint32_t freq);
 
 // Direct parameter setters (for web/serial interface)
+int setBandByIndex(int idx);
 int setBandByName(const char *name);
 int setModeByName(const char *name);
 int setStepByName(const char *name);
@@ -159,5 +161,6 @@ void doStep(int16_t enc);
 void doMode(int16_t enc);
 void doBand(int16_t enc);
 void doSquelch(int16_t enc);
+void doScanZoom(int16_t enc);
 
 #endif // MENU_H
@@ -13,8 +13,10 @@
 #include <ESPAsyncWebServer.h>
 #include <NTPClient.h>
 #include <ESPmDNS.h>
+#include <esp_heap_caps.h>
 
 #define CONNECT_TIME  3000  // Time of inactivity to start connecting WiFi
+#define QUEUE_TIMEOUT 500   // Time to wait for a queued radio command
 
 //
 // Access Point (AP) mode settings
@@ -54,6 +56,12 @@ String loginPassword = "";
 // AsyncWebServer object on port 80
 AsyncWebServer server(80);
 
+// WebSocket mirroring the screen
+AsyncWebSocket screenWs("/screen");
+
+// WebSocket streaming telemetry
+AsyncWebSocket telemetryWs("/telemetry");
+
 // NTP Client to get time
 WiFiUDP ntpUDP;
 NTPClient ntpClient(ntpUDP, "pool.ntp.org");
@@ -66,6 +74,7 @@ static void webInit();
 static void webSetConfig(AsyncWebServerRequest *request);
 static void webSetMemory(AsyncWebServerRequest *request);
 static void webControlCommand(AsyncWebServerRequest *request, char cmd);
+static bool webQueueCommand(AsyncWebServerRequest *request, uint32_t ticket, int32_t *result);
 
 static const String webInputField(const String &name, const String &value, bool pass = false);
 static const String webModernStyleSheet();
@@ -75,6 +84,9 @@ static const String webConfigPage();
 static const String webControlPage();
 static const String webControlStatus();
 static const String webMemoriesJson();
+static const String webScreenPage();
+static void webScreenEvent(AsyncWebSocket *ws, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len);
+static void webTelemetryEvent(AsyncWebSocket *ws, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len);
 
 //
 // Delayed WiFi connection
@@ -100,6 +112,39 @@ void netTickTime()
   {
     wifiTickConnect();
   }
+
+  // Drop disconnected screen viewers and telemetry clients
+  screenWs.cleanupClients();
+  telemetryWs.cleanupClients();
+}
+
+//
+// Check if anybody is watching the screen
+//
+bool netScreenClients()
+{
+  return(screenWs.count() > 0);
+}
+
+//
+// Send screen update to all viewers, returns false if some viewers
+// could not take it
+//
+bool netScreenSend(const uint8_t *data, size_t len)
+{
+  if(!screenWs.availableForWriteAll()) return(false);
+  screenWs.binaryAll(data, len);
+  return(true);
+}
+
+//
+// Send telemetry line to all WebSocket clients, dropping it for
+// clients that can not keep up
+//
+void netTelemetrySend(const char *data, size_t len)
+{
+  if(telemetryWs.count() && telemetryWs.availableForWriteAll())
+    telemetryWs.textAll(data, len);
 }
 
 //
@@ -456,9 +501,10 @@ static void webInit()
       request->send(400, "application/json", "{\"ok\":false,\"error\":\"Invalid slot (1-99)\"}");
       return;
     }
-    if(recallMemorySlot(slot))
+    int32_t result;
+    if(!webQueueCommand(request, queuePost(QUEUE_MEMORY, slot), &result)) return;
+    if(result == 0)
     {
-      prefsRequestSave(SAVE_SETTINGS, false);
       request->send(200, "application/json", "{\"ok\":true}");
     }
     else
@@ -475,10 +521,10 @@ static void webInit()
       return;
     }
     long freq = request->getParam("freq")->value().toInt();
-    int result = tuneToFrequency(freq);
+    int32_t result;
+    if(!webQueueCommand(request, queuePost(QUEUE_TUNE, freq), &result)) return;
     if(result == 0)
     {
-      prefsRequestSave(SAVE_SETTINGS, false);
       request->send(200, "application/json", "{\"ok\":true}");
     }
     else if(result == 1)
@@ -552,10 +598,10 @@ static void webInit()
       return;
     }
     String name = request->getParam("name")->value();
-    int result = setBandByName(name.c_str());
+    int32_t result;
+    if(!webQueueCommand(request, queuePost(QUEUE_SET_BAND, 0, 0, 0, name.c_str()), &result)) return;
     if(result >= 0)
     {
-      prefsRequestSave(SAVE_ALL, false);
       request->send(200, "application/json", "{\"ok\":true}");
     }
     else
@@ -572,10 +618,10 @@ static void webInit()
       return;
     }
     String name = request->getParam("name")->value();
-    int result = setModeByName(name.c_str());
+    int32_t result;
+    if(!webQueueCommand(request, queuePost(QUEUE_SET_MODE, 0, 0, 0, name.c_str()), &result)) return;
     if(result >= 0)
     {
-      prefsRequestSave(SAVE_ALL, false);
       request->send(200, "application/json", "{\"ok\":true}");
     }
     else
@@ -592,10 +638,10 @@ static void webInit()
       return;
     }
     String name = request->getParam("name")->value();
-    int result = setStepByName(name.c_str());
+    int32_t result;
+    if(!webQueueCommand(request, queuePost(QUEUE_SET_STEP, 0, 0, 0, name.c_str()), &result)) return;
     if(result >= 0)
     {
-      prefsRequestSave(SAVE_ALL, false);
       request->send(200, "application/json", "{\"ok\":true}");
     }
     else
@@ -612,10 +658,10 @@ static void webInit()
       return;
     }
     String name = request->getParam("name")->value();
-    int result = setBandwidthByName(name.c_str());
+    int32_t result;
+    if(!webQueueCommand(request, queuePost(QUEUE_SET_BANDWIDTH, 0, 0, 0, name.c_str()), &result)) return;
     if(result >= 0)
     {
-      prefsRequestSave(SAVE_ALL, false);
       request->send(200, "application/json", "{\"ok\":true}");
     }
     else
@@ -632,9 +678,10 @@ static void webInit()
       return;
     }
     int value = request->getParam("value")->value().toInt();
-    if(setAgcValue(value))
+    int32_t result;
+    if(!webQueueCommand(request, queuePost(QUEUE_SET_AGC, value), &result)) return;
+    if(result == 0)
     {
-      prefsRequestSave(SAVE_ALL, false);
       request->send(200, "application/json", "{\"ok\":true}");
     }
     else
@@ -654,12 +701,6 @@ static void webInit()
 
   // Spectrum scan endpoints
   server.on("/scan/run", HTTP_GET, [] (AsyncWebServerRequest *request) {
-    // Don't start if already running
-    if(scanIsRunning())
-    {
-      request->send(200, "application/json", "{\"ok\":true,\"status\":\"running\"}");
-      return;
-    }
     // Get optional step parameter (default based on mode)
     uint16_t step = currentMode == FM ? 10 : 1;
     if(request->hasParam("step"))
@@ -675,11 +716,13 @@ static void webInit()
     if(request->hasParam("start"))
       startFreq = request->getParam("start")->value().toInt();
     // Start async scan - either from start freq or centered on current
-    if(startFreq > 0)
-      scanStartAsyncFrom(startFreq, step, points);
+    // (does not restart a scan that is already running)
+    int32_t result;
+    if(!webQueueCommand(request, queuePost(QUEUE_SCAN, startFreq, step, points), &result)) return;
+    if(result == 1)
+      request->send(200, "application/json", "{\"ok\":true,\"status\":\"running\"}");
     else
-      scanStartAsync(currentFrequency, step, points);
-    request->send(200, "application/json", "{\"ok\":true,\"status\":\"started\"}");
+      request->send(200, "application/json", "{\"ok\":true,\"status\":\"started\"}");
   });
 
   // Get band limits for full-band scanning
@@ -731,6 +774,60 @@ static void webInit()
     request->send(200, "application/json", json);
   });
 
+  // Stations found by the scan of the current band
+  server.on("/scan/peaks", HTTP_GET, [] (AsyncWebServerRequest *request) {
+    ScanPeak peaks[SCAN_PEAKS];
+    uint32_t time;
+    uint8_t count = scanCopyPeaks(bandIdx, peaks, SCAN_PEAKS, &time);
+
+    String json = "{\"ready\":" + String(count || scanIsReady()? "true" : "false");
+    json += ",\"mode\":\"" + String(bandModeDesc[currentMode]) + "\"";
+    json += ",\"band\":\"" + String(getCurrentBand()->bandName) + "\"";
+    json += ",\"age\":" + (time? String((millis() - time) / 1000) : String("null"));
+    json += ",\"peaks\":[";
+
+    for(uint8_t i = 0; i < count; i++)
+    {
+      if(i > 0) json += ",";
+      json += "{\"freq\":" + String(peaks[i].freq);
+      json += ",\"tune\":" + String(peaks[i].tune);
+      json += ",\"rssi\":" + String(peaks[i].rssi);
+      json += ",\"snr\":" + String(peaks[i].snr) + "}";
+    }
+    json += "]}";
+    request->send(200, "application/json", json);
+  });
+
+  // Live screen
+  screenWs.onEvent(webScreenEvent);
+  server.addHandler(&screenWs);
+  telemetryWs.onEvent(webTelemetryEvent);
+  server.addHandler(&telemetryWs);
+  server.on("/mirror", HTTP_GET, [] (AsyncWebServerRequest *request) {
+    request->send(200, "text/html", webScreenPage());
+  });
+
+  server.on("/screenshot.bmp", HTTP_GET, [] (AsyncWebServerRequest *request) {
+    size_t size;
+    uint8_t *bmp = captureBmp(&size);
+    if(!bmp)
+    {
+      request->send(503, "text/plain", "Screenshot not available");
+      return;
+    }
+
+    // Image buffer is freed together with the response
+    std::shared_ptr<uint8_t> data(bmp, heap_caps_free);
+    AsyncWebServerResponse *response = request->beginResponse("image/bmp", size,
+      [data, size] (uint8_t *buf, size_t maxLen, size_t index) -> size_t {
+        size_t n = index < size? min(maxLen, size - index) : 0;
+        memcpy(buf, data.get() + index, n);
+        return(n);
+      });
+    response->addHeader("Cache-Control", "no-store");
+    request->send(response);
+  });
+
   server.onNotFound([] (AsyncWebServerRequest *request) {
     request->send(404, "text/plain", "Not found");
   });
@@ -1144,25 +1241,119 @@ const String webConfigPage()
 //
 static void webControlCommand(AsyncWebServerRequest *request, char cmd)
 {
-  // Handle tuning commands directly since remoteDoCommand only sets event flags
+  uint32_t ticket;
+
+  // Handle tuning commands as steps since remoteDoCommand only sets
+  // event flags. Consecutive steps get merged into a single retune.
   if(cmd == 'R')
+    ticket = queuePost(QUEUE_TUNE_STEP, 1);
+  else if(cmd == 'r')
+    ticket = queuePost(QUEUE_TUNE_STEP, -1);
+  else
+    ticket = queuePost(QUEUE_KEY, cmd);
+
+  int32_t result;
+  if(!webQueueCommand(request, ticket, &result)) return;
+
+  String json = "{\"ok\":true,\"cmd\":\"" + String(cmd) + "\"}";
+  request->send(200, "application/json", json);
+}
+
+//
+// Wait for a queued radio command to be executed by the main loop.
+// Returns false if the response has already been sent, i.e. when the
+// queue is full or the command is still pending.
+//
+static bool webQueueCommand(AsyncWebServerRequest *request, uint32_t ticket, int32_t *result)
+{
+  if(!ticket)
   {
-    doTune(1);
-    prefsRequestSave(SAVE_ALL, false);
+    request->send(503, "application/json", "{\"ok\":false,\"error\":\"Radio busy\"}");
+    return(false);
   }
-  else if(cmd == 'r')
+
+  if(!queueWait(ticket, result, QUEUE_TIMEOUT))
   {
-    doTune(-1);
-    prefsRequestSave(SAVE_ALL, false);
+    request->send(202, "application/json", "{\"ok\":true,\"pending\":true}");
+    return(false);
   }
-  else
+
+  return(true);
+}
+
+//
+// New screen viewers need a whole frame
+//
+static void webScreenEvent(AsyncWebSocket *ws, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
+{
+  if(type==WS_EVT_CONNECT) captureMirrorRefresh();
+}
+
+//
+// Telemetry clients subscribe by sending "<period>[,<fields>]" text,
+// the stream stops when the last client disconnects
+//
+static void webTelemetryEvent(AsyncWebSocket *ws, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
+{
+  if(type==WS_EVT_DISCONNECT && !ws->count())
+    telemetrySubscribe(TELEMETRY_WS, 0, 0);
+  else if(type==WS_EVT_DATA)
   {
-    int result = remoteDoCommand(cmd);
-    if(result & REMOTE_PREFS)
-      prefsRequestSave(SAVE_ALL, false);
+    AwsFrameInfo *info = (AwsFrameInfo *)arg;
+    char args[24];
+
+    if(!info->final || info->index || info->len!=len || len>=sizeof(args)) return;
+    memcpy(args, data, len);
+    args[len] = '\0';
+    if(!telemetryConfigure(TELEMETRY_WS, args))
+      client->text("Error: Invalid subscription");
   }
-  String json = "{\"ok\":true,\"cmd\":\"" + String(cmd) + "\"}";
-  request->send(200, "application/json", json);
+}
+
+//
+// Live screen page, decodes updates sent to /screen
+//
+static const String webScreenPage()
+{
+  return
+"<!DOCTYPE html><html><head>"
+"<meta charset='UTF-8'>"
+"<meta name='viewport' content='width=device-width,initial-scale=1.0'>"
+"<title>ATS-Mini Monster edition - Screen</title>"
+"<style>" + webModernStyleSheet() + "canvas{width:100%;max-width:640px;image-rendering:pixelated;background:#000}</style>"
+"</head><body>"
+"<div class='container'>"
+"<h1>ATS-Mini Monster edition - Screen</h1>"
+"<p class='nav'><a href='/'>Control</a> | <a href='/screenshot.bmp'>Screenshot</a> | <span id='state'>Connecting</span></p>"
+"<canvas id='screen' width='320' height='170'></canvas>"
+"</div>"
+"<script>"
+"var cv=document.getElementById('screen'),g=cv.getContext('2d'),im=g.createImageData(320,170),d=im.data;"
+"function px(o,v){d[o]=(v>>8&248)|(v>>13);d[o+1]=(v>>3&252)|(v>>9&3);d[o+2]=(v<<3&248)|(v>>2&7);d[o+3]=255;}"
+"function conn(){"
+  "var ws=new WebSocket('ws://'+location.host+'/screen'),st=document.getElementById('state');"
+  "ws.binaryType='arraybuffer';"
+  "ws.onopen=function(){st.textContent='Live';};"
+  "ws.onclose=function(){st.textContent='Reconnecting';setTimeout(conn,2000);};"
+  "ws.onmessage=function(e){"
+    "var b=new Uint8Array(e.data),i=0;"
+    "while(i+8<=b.length){"
+      "var x=b[i]|b[i+1]<<8,y=b[i+2]|b[i+3]<<8,w=b[i+4]|b[i+5]<<8,h=b[i+6]|b[i+7]<<8;i+=8;"
+      "for(var r=0;r<h;r++){"
+        "var o=((y+r)*320+x)*4,n=0;"
+        "while(n<w){"
+          "var k=b[i++];"
+          "if(k>=128){var v=b[i]|b[i+1]<<8;i+=2;for(k-=125;k>0;k--,n++,o+=4)px(o,v);}"
+          "else for(k++;k>0;k--,n++,o+=4,i+=2)px(o,b[i]|b[i+1]<<8);"
+        "}"
+      "}"
+    "}"
+    "g.putImageData(im,0,0);"
+  "};"
+"}"
+"conn();"
+"</script>"
+"</body></html>";
 }
 
 //
@@ -1170,12 +1361,11 @@ static void webControlCommand(AsyncWebServerRequest *request, char cmd)
 //
 static const String webControlStatus()
 {
-  rx.getCurrentReceivedSignalQuality();
-  uint8_t remoteRssi = rx.getCurrentRSSI();
-  uint8_t remoteSnr = rx.getCurrentSNR();
-  rx.getFrequency();
-  uint16_t tuningCapacitor = rx.getAntennaTuningCapacitor();
-  float voltage = batteryMonitor();
+  // Runs on the web server task, so only use values published by
+  // the main loop and never talk to the chip from here
+  uint8_t remoteRssi, remoteSnr;
+  uint16_t tuningCapacitor, voltage;
+  telemetryCached(&remoteRssi, &remoteSnr, &tuningCapacitor, &voltage);
 
   String freq = currentMode == FM ?
     String(currentFrequency / 100.0, 1) + " MHz" :
@@ -1199,7 +1389,7 @@ static const String webControlStatus()
   json += "\"rssi\":" + String(remoteRssi) + ",";
   json += "\"snr\":" + String(remoteSnr) + ",";
   json += "\"capacitor\":" + String(tuningCapacitor) + ",";
-  json += "\"voltage\":" + String(voltage, 2) + ",";
+  json += "\"voltage\":" + String(voltage / 1000.0, 2) + ",";
   json += "\"brightness\":" + String(currentBrt) + ",";
   json += "\"menuState\":\"" + String(getMenuStateName()) + "\",";
   json += "\"menuItem\":\"" + String(getMenuItemName()) + "\",";
@@ -1250,7 +1440,7 @@ static const String webControlPage()
       "<span id='voltage'>--V</span>"
     "</div>"
     "<div class='nav'>"
-      "<a href='/config'>Config</a>"
+      "<a href='/config'>Config</a> | <a href='/mirror'>Screen</a>"
     "</div>"
   "</div>"
 "</header>"
@@ -0,0 +1,484 @@
+#include "Common.h"
+#include "Themes.h"
+#include "Utils.h"
+#include "Menu.h"
+#include "Storage.h"
+
+//
+// Binary remote protocol
+//
+// Runs on the serial port alongside the single character commands.
+// Every frame starts with PROTO_SYNC, a byte that never appears in the
+// text commands, so both can be used at any time:
+//
+//   SYNC, VERSION, LENGTH (2), ID (2), COMMAND, DATA (LENGTH), CRC (2)
+//
+// All numbers are little endian. CRC is CRC-16/CCITT-FALSE over all
+// bytes from VERSION to the end of DATA. Every request gets a reply
+// with the same ID, COMMAND | PROTO_REPLY, and a status byte followed
+// by the reply data. Unsolicited frames (subscriptions) have ID 0.
+//
+
+#define PROTO_SYNC       0xA5 // Frame start
+#define PROTO_VERSION    1    // Protocol version
+#define PROTO_HEADER     7    // SYNC, VERSION, LENGTH, ID, COMMAND
+#define PROTO_MAX_DATA   512  // Maximum data length
+#define PROTO_TIMEOUT    200  // Drop incomplete frames after this (ms)
+#define PROTO_MIN_PERIOD 20   // Minimum status period (ms)
+
+// Commands
+#define PROTO_PING       0x01 // -> version, firmware (2)
+#define PROTO_GET        0x02 // param -> value (4)
+#define PROTO_SET        0x03 // param, value (4) -> value (4)
+#define PROTO_MEM_READ   0x04 // slot, count -> slot, count, Memory[count]
+#define PROTO_MEM_WRITE  0x05 // slot, Memory[n] -> count
+#define PROTO_SCAN_START 0x06 // start (2, 0 = centered), step (2), points (2)
+#define PROTO_SCAN_READ  0x07 // offset (2), count (2) -> scan chunk
+#define PROTO_SUBSCRIBE  0x08 // mask, period (2)
+#define PROTO_STATUS     0x40 // Unsolicited status
+#define PROTO_SCAN_DATA  0x41 // Unsolicited scan chunk
+#define PROTO_REPLY      0x80 // Reply flag
+
+// Reply status
+#define PROTO_OK         0
+#define PROTO_ERR_CMD    1    // Unknown command
+#define PROTO_ERR_ARG    2    // Malformed arguments
+#define PROTO_ERR_RANGE  3    // Value out of range
+#define PROTO_ERR_BUSY   4    // Not possible right now
+#define PROTO_ERR_CRC    5    // Frame damaged
+
+// Parameters for PROTO_GET/PROTO_SET
+#define PARAM_FREQ       1    // Frequency (FM = 10 kHz, AM/SSB = 1 kHz)
+#define PARAM_BFO        2    // BFO (Hz), read only
+#define PARAM_BAND       3    // Band index
+#define PARAM_MODE       4    // Mode index
+#define PARAM_STEP       5    // Step index for the current mode
+#define PARAM_BANDWIDTH  6    // Bandwidth index for the current mode
+#define PARAM_AGC        7    // AGC/attenuation
+#define PARAM_VOLUME     8    // Volume (0-63)
+#define PARAM_SQUELCH    9    // Squelch (0-127)
+#define PARAM_BRIGHTNESS 10   // Backlight (10-255)
+#define PARAM_CAL        11   // SSB calibration for the current band and mode
+#define PARAM_RSSI       12   // RSSI (dBuV), read only
+#define PARAM_SNR        13   // SNR (dB), read only
+#define PARAM_VOLTAGE    14   // Battery voltage (mV), read only
+#define PARAM_SLEEP      15   // Display sleep (0/1)
+
+// Subscriptions
+#define SUB_STATUS       0x01 // Periodic PROTO_STATUS frames
+#define SUB_SCAN         0x02 // PROTO_SCAN_DATA frames when a scan completes
+
+#define SCAN_CHUNK       250  // Scan points per chunk
+
+static uint8_t  protoBuf[PROTO_HEADER + PROTO_MAX_DATA + 2];
+static uint16_t protoPos = 0;
+static uint32_t protoTime = 0;
+static bool     protoSkip = false;  // Discarding input after a framing error
+
+static uint8_t  protoSubs = 0;
+static uint16_t protoPeriod = 500;
+static uint32_t protoStatusTime = 0;
+static uint32_t protoScanVersion = 0;
+static uint8_t  protoSeqnum = 0;
+
+static inline uint16_t get16(const uint8_t *p) { return(p[0] | (p[1] << 8)); }
+static inline uint32_t get32(const uint8_t *p) { return(p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24)); }
+static inline void put16(uint8_t *p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static inline void put32(uint8_t *p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+
+static uint16_t protoCrc(const uint8_t *data, int len, uint16_t crc = 0xFFFF)
+{
+  while(len--)
+  {
+    crc ^= *data++ << 8;
+    for(int j=0 ; j<8 ; j++)
+      crc = crc & 0x8000? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return(crc);
+}
+
+//
+// Send a frame
+//
+static void protoSend(uint8_t cmd, uint16_t id, const uint8_t *data, uint16_t len)
+{
+  uint8_t hdr[PROTO_HEADER];
+  uint8_t crc[2];
+
+  hdr[0] = PROTO_SYNC;
+  hdr[1] = PROTO_VERSION;
+  put16(hdr + 2, len);
+  put16(hdr + 4, id);
+  hdr[6] = cmd;
+  put16(crc, protoCrc(data, len, protoCrc(hdr + 1, PROTO_HEADER - 1)));
+
+  Serial.write(hdr, sizeof(hdr));
+  Serial.write(data, len);
+  Serial.write(crc, sizeof(crc));
+}
+
+static void protoReply(uint8_t cmd, uint16_t id, uint8_t status, const uint8_t *data = 0, uint16_t len = 0)
+{
+  uint8_t buf[1 + PROTO_MAX_DATA];
+
+  buf[0] = status;
+  if(len) memcpy(buf + 1, data, len);
+  protoSend(cmd | PROTO_REPLY, id, buf, len + 1);
+}
+
+//
+// Get parameter value, returns false for unknown parameters
+//
+static bool protoGet(uint8_t param, int32_t *value)
+{
+  uint8_t rssi, snr;
+
+  switch(param)
+  {
+    case PARAM_FREQ:       *value = currentFrequency; break;
+    case PARAM_BFO:        *value = currentBFO; break;
+    case PARAM_BAND:       *value = bandIdx; break;
+    case PARAM_MODE:       *value = currentMode; break;
+    case PARAM_STEP:       *value = getCurrentStepIdx(); break;
+    case PARAM_BANDWIDTH:  *value = getCurrentBandwidthIdx(); break;
+    case PARAM_AGC:        *value = getCurrentAgc(); break;
+    case PARAM_VOLUME:     *value = volume; break;
+    case PARAM_SQUELCH:    *value = currentSquelch; break;
+    case PARAM_BRIGHTNESS: *value = currentBrt; break;
+    case PARAM_RSSI:       telemetrySignal(&rssi, &snr, TELEMETRY_MAX_AGE); *value = rssi; break;
+    case PARAM_SNR:        telemetrySignal(&rssi, &snr, TELEMETRY_MAX_AGE); *value = snr; break;
+    case PARAM_VOLTAGE:    *value = telemetryVoltage(); break;
+    case PARAM_SLEEP:      *value = sleepOn(); break;
+    case PARAM_CAL:
+      *value = currentMode==USB? getCurrentBand()->usbCal :
+               currentMode==LSB? getCurrentBand()->lsbCal : 0;
+      break;
+    default:
+      return(false);
+  }
+
+  return(true);
+}
+
+//
+// Set parameter value, returns reply status
+//
+static uint8_t protoSet(uint8_t param, int32_t value)
+{
+  const char *desc;
+
+  switch(param)
+  {
+    case PARAM_FREQ:
+      if(tuneToFrequency(value)) return(PROTO_ERR_RANGE);
+      break;
+    case PARAM_BAND:
+      if(setBandByIndex(value) < 0) return(PROTO_ERR_RANGE);
+      break;
+    case PARAM_MODE:
+      if(value < 0 || value >= getTotalModes() || setModeByName(bandModeDesc[value]) < 0)
+        return(PROTO_ERR_RANGE);
+      break;
+    case PARAM_STEP:
+      if(!(desc = getStepDesc(value)) || setStepByName(desc) < 0) return(PROTO_ERR_RANGE);
+      break;
+    case PARAM_BANDWIDTH:
+      if(!(desc = getBandwidthDesc(value)) || setBandwidthByName(desc) < 0) return(PROTO_ERR_RANGE);
+      break;
+    case PARAM_AGC:
+      if(!setAgcValue(value)) return(PROTO_ERR_RANGE);
+      break;
+    case PARAM_VOLUME:
+      if(value < 0 || value > 63) return(PROTO_ERR_RANGE);
+      doVolume(value - volume);
+      break;
+    case PARAM_SQUELCH:
+      if(value < 0 || value > 127) return(PROTO_ERR_RANGE);
+      currentSquelch = value;
+      break;
+    case PARAM_BRIGHTNESS:
+      if(value < 10 || value > 255) return(PROTO_ERR_RANGE);
+      currentBrt = value;
+      if(!sleepOn()) ledcWrite(PIN_LCD_BL, currentBrt);
+      break;
+    case PARAM_CAL:
+      if(!isSSB()) return(PROTO_ERR_BUSY);
+      if(value < -MAX_CAL || value > MAX_CAL) return(PROTO_ERR_RANGE);
+      if(currentMode == USB) getCurrentBand()->usbCal = value;
+      else getCurrentBand()->lsbCal = value;
+      updateBFO(currentBFO, true);
+      break;
+    case PARAM_SLEEP:
+      sleepOn(!!value);
+      break;
+    default:
+      return(PROTO_ERR_ARG);
+  }
+
+  return(PROTO_OK);
+}
+
+//
+// Execute a received frame, returns REMOTE_* events
+//
+static int protoExecute(uint8_t cmd, uint16_t id, const uint8_t *data, uint16_t len)
+{
+  uint8_t buf[PROTO_MAX_DATA];
+  int32_t value;
+  uint8_t status;
+
+  switch(cmd)
+  {
+    case PROTO_PING:
+      buf[0] = PROTO_VERSION;
+      put16(buf + 1, VER_APP);
+      protoReply(cmd, id, PROTO_OK, buf, 3);
+      return(0);
+
+    case PROTO_GET:
+      if(len != 1 || !protoGet(data[0], &value))
+      {
+        protoReply(cmd, id, PROTO_ERR_ARG);
+        return(0);
+      }
+      put32(buf, value);
+      protoReply(cmd, id, PROTO_OK, buf, 4);
+      return(0);
+
+    case PROTO_SET:
+      if(len != 5)
+      {
+        protoReply(cmd, id, PROTO_ERR_ARG);
+        return(0);
+      }
+      status = protoSet(data[0], get32(data + 1));
+      protoGet(data[0], &value);
+      put32(buf, value);
+      protoReply(cmd, id, status, buf, 4);
+      return(status==PROTO_OK? REMOTE_CHANGED | REMOTE_PREFS : 0);
+
+    case PROTO_MEM_READ:
+      {
+        if(len != 2 || data[0] < 1 || data[0] > getTotalMemories())
+        {
+          protoReply(cmd, id, PROTO_ERR_ARG);
+          return(0);
+        }
+
+        uint8_t count = min((int)data[1], getTotalMemories() - data[0] + 1);
+        count = min((int)count, (PROTO_MAX_DATA - 3) / (int)sizeof(Memory));
+
+        buf[0] = data[0];
+        buf[1] = count;
+        memcpy(buf + 2, &memories[data[0] - 1], count * sizeof(Memory));
+        protoReply(cmd, id, PROTO_OK, buf, 2 + count * sizeof(Memory));
+      }
+      return(0);
+
+    case PROTO_MEM_WRITE:
+      {
+        uint8_t count = len? (len - 1) / sizeof(Memory) : 0;
+        Memory mem[PROTO_MAX_DATA / sizeof(Memory)];
+
+        if(!len || (len - 1) % sizeof(Memory) || data[0] < 1 || data[0] + count - 1 > getTotalMemories())
+        {
+          protoReply(cmd, id, PROTO_ERR_ARG);
+          return(0);
+        }
+
+        // Validate all slots before writing any of them
+        memcpy(mem, data + 1, count * sizeof(Memory));
+        for(int j=0 ; j<count ; j++)
+        {
+          if(!mem[j].freq)
+            memset(&mem[j], 0, sizeof(Memory));
+          else if(mem[j].band >= getTotalBands() || mem[j].mode >= getTotalModes() ||
+                  !isMemoryInBand(&bands[mem[j].band], &mem[j]))
+          {
+            buf[0] = j;
+            protoReply(cmd, id, PROTO_ERR_RANGE, buf, 1);
+            return(0);
+          }
+        }
+
+        memcpy(&memories[data[0] - 1], mem, count * sizeof(Memory));
+        prefsRequestSave(SAVE_MEMORIES, true);
+        buf[0] = count;
+        protoReply(cmd, id, PROTO_OK, buf, 1);
+      }
+      return(REMOTE_CHANGED);
+
+    case PROTO_SCAN_START:
+      if(len != 6)
+      {
+        protoReply(cmd, id, PROTO_ERR_ARG);
+        return(0);
+      }
+      if(scanIsRunning())
+      {
+        protoReply(cmd, id, PROTO_ERR_BUSY);
+        return(0);
+      }
+      if(get16(data))
+        scanStartAsyncFrom(get16(data), get16(data + 2), get16(data + 4));
+      else
+        scanStartAsync(currentFrequency, get16(data + 2), get16(data + 4));
+      protoReply(cmd, id, PROTO_OK);
+      return(REMOTE_CHANGED);
+
+    case PROTO_SCAN_READ:
+      if(len != 4)
+      {
+        protoReply(cmd, id, PROTO_ERR_ARG);
+        return(0);
+      }
+      len = scanGetChunk(buf, get16(data), min((int)get16(data + 2), SCAN_CHUNK));
+      if(len)
+        protoReply(cmd, id, PROTO_OK, buf, len);
+      else
+        protoReply(cmd, id, PROTO_ERR_BUSY);
+      return(0);
+
+    case PROTO_SUBSCRIBE:
+      if(len != 3)
+      {
+        protoReply(cmd, id, PROTO_ERR_ARG);
+        return(0);
+      }
+      protoSubs = data[0];
+      protoPeriod = max((int)get16(data + 1), PROTO_MIN_PERIOD);
+      // Stream existing scan data right away
+      protoScanVersion = 0;
+      protoReply(cmd, id, PROTO_OK);
+      return(0);
+  }
+
+  protoReply(cmd, id, PROTO_ERR_CMD);
+  return(0);
+}
+
+//
+// Check if the next serial byte belongs to a binary frame
+//
+bool protoIsPending()
+{
+  return(protoPos || protoSkip || Serial.peek()==PROTO_SYNC);
+}
+
+//
+// Receive available frame bytes, executing complete frames
+// Returns REMOTE_* events
+//
+int protoReceive()
+{
+  int event = 0;
+
+  while(Serial.available() > 0)
+  {
+    uint8_t c = Serial.read();
+
+    // After a framing error, the rest of the damaged frame must not
+    // reach the text command parser: swallow everything up to the
+    // next frame start or until the line goes idle
+    if(protoSkip)
+    {
+      protoTime = millis();
+      if(c!=PROTO_SYNC) continue;
+      protoSkip = false;
+    }
+
+    // Wait for frame start
+    if(!protoPos && c!=PROTO_SYNC) break;
+
+    protoBuf[protoPos++] = c;
+    protoTime = millis();
+
+    if(protoPos < PROTO_HEADER) continue;
+
+    uint16_t len = get16(protoBuf + 2);
+    if(protoBuf[1]!=PROTO_VERSION || len>PROTO_MAX_DATA)
+    {
+      // Can not tell where this frame ends, drop it
+      protoPos  = 0;
+      protoSkip = true;
+      continue;
+    }
+
+    if(protoPos < PROTO_HEADER + len + 2) continue;
+
+    // Have the whole frame
+    uint16_t id = get16(protoBuf + 4);
+    uint8_t cmd = protoBuf[6];
+    protoPos = 0;
+
+    if(protoCrc(protoBuf + 1, PROTO_HEADER - 1 + len) != get16(protoBuf + PROTO_HEADER + len))
+      protoReply(cmd, id, PROTO_ERR_CRC);
+    else
+      event |= protoExecute(cmd, id, protoBuf + PROTO_HEADER, len);
+
+    // Leave remaining input for the next call
+    break;
+  }
+
+  return(event);
+}
+
+//
+// Send status frame: frequency (2), BFO (2), band, mode, step,
+// bandwidth, AGC, volume, RSSI, SNR, voltage (2, mV), sequence number
+//
+static void protoSendStatus()
+{
+  uint8_t buf[16];
+  uint8_t rssi, snr;
+
+  telemetrySignal(&rssi, &snr, TELEMETRY_MAX_AGE);
+
+  put16(buf, currentFrequency);
+  put16(buf + 2, currentBFO);
+  buf[4]  = bandIdx;
+  buf[5]  = currentMode;
+  buf[6]  = getCurrentStepIdx();
+  buf[7]  = getCurrentBandwidthIdx();
+  buf[8]  = getCurrentAgc();
+  buf[9]  = volume;
+  buf[10] = rssi;
+  buf[11] = snr;
+  put16(buf + 12, telemetryVoltage());
+  buf[14] = protoSeqnum++;
+  buf[15] = sleepOn();
+
+  protoSend(PROTO_STATUS, 0, buf, sizeof(buf));
+}
+
+//
+// Drop stale partial frames and serve subscriptions
+//
+void protoTickTime()
+{
+  uint32_t now = millis();
+
+  // Drop a stalled partial frame, still swallowing whatever is left of
+  // it, and return to text commands once the line has been idle
+  if((protoPos || protoSkip) && (now - protoTime) > PROTO_TIMEOUT)
+  {
+    protoSkip = protoPos > 0;
+    protoPos  = 0;
+    protoTime = now;
+  }
+
+  if((protoSubs & SUB_STATUS) && (now - protoStatusTime) >= protoPeriod)
+  {
+    protoStatusTime = now;
+    protoSendStatus();
+  }
+
+  // Stream completed scans
+  if((protoSubs & SUB_SCAN) && scanIsReady() && protoScanVersion!=scanGetVersion())
+  {
+    uint8_t buf[PROTO_MAX_DATA];
+    protoScanVersion = scanGetVersion();
+    for(uint16_t offset=0, len ; (len = scanGetChunk(buf, offset, SCAN_CHUNK)) > 10 ; offset += SCAN_CHUNK)
+      protoSend(PROTO_SCAN_DATA, 0, buf, len);
+  }
+}
@@ -0,0 +1,277 @@
+#include "Common.h"
+#include "Menu.h"
+#include "Storage.h"
+#include "Utils.h"
+
+//
+// Radio command queue
+//
+// Web and BLE handlers run in their own FreeRTOS tasks, concurrently
+// with loop(). They must not touch the SI4732 or the band state
+// directly. Instead, they post typed commands here and get a ticket
+// back. The main loop drains the queue via queueTickTime(), so all
+// radio accesses happen from a single task. Posters may wait on the
+// ticket to obtain the command result.
+//
+// Consecutive tune commands are coalesced while still pending, so a
+// slider dragged across many frequencies results in a single retune.
+//
+
+#define QUEUE_SIZE     16   // Maximum number of pending commands
+#define QUEUE_RESULTS  16   // Number of completed results kept for waiters
+#define QUEUE_POLL_MS  2    // Result polling interval in queueWait()
+#define QUEUE_NAME_LEN 16   // Maximum length of a name argument
+
+typedef struct
+{
+  uint8_t  type;                 // Command type (QUEUE_*)
+  uint32_t first;                // First ticket served by this command
+  uint32_t last;                 // Last ticket served by this command
+  int32_t  arg1;                 // Command arguments
+  int32_t  arg2;
+  int32_t  arg3;
+  char     name[QUEUE_NAME_LEN]; // Name argument (band, mode, etc)
+} QueueCmd;
+
+typedef struct
+{
+  uint32_t first;                // First ticket of the completed command
+  uint32_t last;                 // Last ticket of the completed command
+  int32_t  result;               // Command result
+} QueueResult;
+
+static portMUX_TYPE queueLock = portMUX_INITIALIZER_UNLOCKED;
+
+static QueueCmd queue[QUEUE_SIZE];
+static uint8_t  queueHead  = 0;
+static uint8_t  queueCount = 0;
+static uint32_t queueTicket = 0;
+
+static QueueResult queueResults[QUEUE_RESULTS];
+static uint8_t     queueResultIdx = 0;
+
+//
+// Check if commands of given type can be merged into one
+//
+static inline bool queueCanCoalesce(uint8_t type)
+{
+  return(type==QUEUE_TUNE || type==QUEUE_TUNE_STEP);
+}
+
+//
+// Post a command to the queue, returns ticket or 0 if the queue is full
+// Safe to call from any task, but not from an ISR
+//
+uint32_t queuePost(uint8_t type, int32_t arg1, int32_t arg2, int32_t arg3, const char *name)
+{
+  uint32_t ticket = 0;
+
+  portENTER_CRITICAL(&queueLock);
+
+  QueueCmd *tail = queueCount? &queue[(queueHead + queueCount - 1) % QUEUE_SIZE] : 0;
+
+  if(tail && tail->type==type && queueCanCoalesce(type))
+  {
+    // Merge into the pending command: absolute tune replaces the
+    // frequency, relative tune accumulates the steps
+    ticket = tail->last = ++queueTicket;
+    tail->arg1 = type==QUEUE_TUNE? arg1 : tail->arg1 + arg1;
+  }
+  else if(queueCount < QUEUE_SIZE)
+  {
+    QueueCmd *cmd = &queue[(queueHead + queueCount++) % QUEUE_SIZE];
+    ticket = cmd->first = cmd->last = ++queueTicket;
+    cmd->type = type;
+    cmd->arg1 = arg1;
+    cmd->arg2 = arg2;
+    cmd->arg3 = arg3;
+    strlcpy(cmd->name, name? name : "", sizeof(cmd->name));
+  }
+
+  portEXIT_CRITICAL(&queueLock);
+
+  return(ticket);
+}
+
+//
+// Wait for a posted command to complete, returns false on timeout
+// Must not be called from the main loop, as it would block the queue
+//
+bool queueWait(uint32_t ticket, int32_t *result, uint32_t timeout)
+{
+  uint32_t start = millis();
+
+  if(!ticket) return(false);
+
+  while(true)
+  {
+    bool done = false;
+
+    portENTER_CRITICAL(&queueLock);
+    for(int j=0 ; j<QUEUE_RESULTS ; j++)
+    {
+      const QueueResult *r = &queueResults[j];
+      if(r->first && ticket>=r->first && ticket<=r->last)
+      {
+        if(result) *result = r->result;
+        done = true;
+        break;
+      }
+    }
+    portEXIT_CRITICAL(&queueLock);
+
+    if(done) return(true);
+    if((millis() - start) >= timeout) return(false);
+
+    vTaskDelay(pdMS_TO_TICKS(QUEUE_POLL_MS));
+  }
+}
+
+//
+// Execute a single command from the main loop, returns command result
+//
+static int32_t queueExecute(const QueueCmd *cmd, bool *changed)
+{
+  int32_t result = -1;
+
+  switch(cmd->type)
+  {
+    case QUEUE_TUNE:
+      result = tuneToFrequency(cmd->arg1);
+      if(!result) prefsRequestSave(SAVE_SETTINGS);
+      break;
+
+    case QUEUE_TUNE_STEP:
+      doTune(cmd->arg1);
+      prefsRequestSave(SAVE_ALL);
+      result = 0;
+      break;
+
+    case QUEUE_KEY:
+      result = remoteDoCommand((char)cmd->arg1);
+      if(result & REMOTE_PREFS) prefsRequestSave(SAVE_ALL);
+      break;
+
+    case QUEUE_MEMORY:
+      result = recallMemorySlot(cmd->arg1)? 0 : -1;
+      if(!result) prefsRequestSave(SAVE_SETTINGS);
+      break;
+
+    case QUEUE_SET_BAND:
+      result = cmd->name[0]? setBandByName(cmd->name) : setBandByIndex(cmd->arg1);
+      if(result>=0) prefsRequestSave(SAVE_ALL);
+      break;
+
+    case QUEUE_SET_MODE:
+      result = setModeByName(cmd->name);
+      if(result>=0) prefsRequestSave(SAVE_ALL);
+      break;
+
+    case QUEUE_SET_STEP:
+      result = setStepByName(cmd->name);
+      if(result>=0) prefsRequestSave(SAVE_ALL);
+      break;
+
+    case QUEUE_SET_BANDWIDTH:
+      result = setBandwidthByName(cmd->name);
+      if(result>=0) prefsRequestSave(SAVE_ALL);
+      break;
+
+    case QUEUE_SET_AGC:
+      result = setAgcValue(cmd->arg1)? 0 : -1;
+      if(!result) prefsRequestSave(SAVE_ALL);
+      break;
+
+    case QUEUE_SCAN:
+      // Do not restart a running scan
+      if(scanIsRunning())
+        result = 1;
+      else
+      {
+        if(cmd->arg1)
+          scanStartAsyncFrom(cmd->arg1, cmd->arg2, cmd->arg3);
+        else
+          scanStartAsync(currentFrequency, cmd->arg2, cmd->arg3);
+        result = 0;
+      }
+      break;
+
+    case QUEUE_REDRAW:
+      result = 0;
+      break;
+
+    case QUEUE_SET_VOLUME:
+      if(cmd->arg1<0 || cmd->arg1>63) break;
+      doVolume(cmd->arg1 - volume);
+      prefsRequestSave(SAVE_SETTINGS);
+      result = 0;
+      break;
+
+    case QUEUE_SET_MEMORY:
+      {
+        Memory mem;
+        memset(&mem, 0, sizeof(mem));
+        mem.freq  = cmd->arg2;
+        mem.band  = cmd->arg3 & 0xFF;
+        mem.mode  = (cmd->arg3 >> 8) & 0xFF;
+        mem.flags = (cmd->arg3 >> 16) & 0xFF;
+        strlcpy(mem.name, cmd->name, sizeof(mem.name));
+
+        if(cmd->arg1<1 || cmd->arg1>getTotalMemories()) break;
+
+        // Zero frequency clears the slot
+        if(mem.freq && (mem.band>=getTotalBands() || mem.mode>=getTotalModes() ||
+                        !isMemoryInBand(&bands[mem.band], &mem))) break;
+
+        if(!mem.freq) memset(&mem, 0, sizeof(mem));
+        memories[cmd->arg1 - 1] = mem;
+        prefsRequestSave(SAVE_MEMORIES, true);
+        result = 0;
+      }
+      break;
+  }
+
+  *changed = true;
+  return(result);
+}
+
+//
+// Execute pending commands, returns true if the screen needs redraw
+// Called from the main loop only
+//
+bool queueTickTime()
+{
+  bool changed = false;
+
+  // Only execute commands present at entry, so that a chatty
+  // client can not starve the main loop
+  for(int n=queueCount ; n>0 ; n--)
+  {
+    QueueCmd cmd;
+
+    // Take command off the queue, so that it can not be coalesced
+    // with while it is being executed
+    portENTER_CRITICAL(&queueLock);
+    if(!queueCount)
+    {
+      portEXIT_CRITICAL(&queueLock);
+      break;
+    }
+    cmd = queue[queueHead];
+    queueHead = (queueHead + 1) % QUEUE_SIZE;
+    queueCount--;
+    portEXIT_CRITICAL(&queueLock);
+
+    int32_t result = queueExecute(&cmd, &changed);
+
+    // Publish result for all tickets served by this command
+    portENTER_CRITICAL(&queueLock);
+    queueResults[queueResultIdx].first  = cmd.first;
+    queueResults[queueResultIdx].last   = cmd.last;
+    queueResults[queueResultIdx].result = result;
+    queueResultIdx = (queueResultIdx + 1) % QUEUE_RESULTS;
+    portEXIT_CRITICAL(&queueLock);
+  }
+
+  return(changed);
+}
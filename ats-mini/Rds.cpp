@@ -0,0 +1,423 @@
+#include "Common.h"
+
+//
+// RDS group decoder
+//
+// Every poll drains the whole SI4735 RDS FIFO and decodes each group,
+// instead of sampling a single group per poll. Every block comes with
+// an error level from the chip: 0 = no errors, 1-2 = corrected, 3 =
+// uncorrectable. Uncorrectable blocks are ignored, the rest vote on the
+// decoded values: an error-free block gives two votes, a corrected one
+// gives a single vote, and a value is confirmed with RDS_VOTES votes in
+// a row. This locks PS/RT quickly on clean signals, while a single bad
+// correction on a weak signal can not change what is shown.
+//
+
+#define RDS_VOTES     2    // Votes needed to confirm a value
+#define RDS_MAX_VOTES 8    // Vote count limit
+#define RDS_FIFO_MAX  32   // Maximum groups drained per poll
+#define RDS_PS_LEN    8    // Station name length
+#define RDS_RT_LEN    64   // Radio text length
+#define RDS_AF_MAX    25   // Maximum alternative frequencies
+
+// Block error levels
+#define RDS_ERR_NONE  0
+#define RDS_ERR_BAD   3
+
+typedef struct
+{
+  char value;              // Confirmed character (0 = none)
+  char cand;               // Candidate character
+  uint8_t votes;           // Candidate votes
+} RdsChar;
+
+static RdsChar  rdsPS[RDS_PS_LEN];
+static RdsChar  rdsRT[RDS_RT_LEN];
+static uint8_t  rdsRTFlag = 0xFF;  // Radio text A/B flag
+static uint8_t  rdsRTLen = RDS_RT_LEN;
+static char     rdsPSText[RDS_PS_LEN + 1];
+static char     rdsRTText[RDS_RT_LEN + 1];
+
+static uint16_t rdsPI = 0, rdsPICand = 0;
+static uint8_t  rdsPIVotes = 0;
+static int8_t   rdsPTY = -1;
+static uint8_t  rdsPTYCand = 0, rdsPTYVotes = 0;
+
+static bool     rdsTimeNew = false;
+static uint8_t  rdsHours, rdsMinutes;
+
+static uint16_t rdsAF[RDS_AF_MAX];
+static uint8_t  rdsAFCount = 0;
+  rdsAFSkip = false;
+static bool     rdsAFSkip = false;      // Next AF code is an LF/MF frequency
+
+static RdsStats rdsStats;
+static uint16_t rdsQuality = 0;    // Usable blocks (%), times 256
+static bool     rdsFlush = true;   // TRUE: drop groups left in the FIFO
+
+static inline uint8_t rdsWeight(uint8_t err)
+{
+  return(err==RDS_ERR_NONE? 2 : err<RDS_ERR_BAD? 1 : 0);
+}
+
+//
+// Vote for a character, returns true if the confirmed one has changed
+//
+static bool rdsVote(RdsChar *c, char ch, uint8_t weight)
+{
+  if(!weight) return(false);
+
+  if(c->cand == ch)
+    c->votes = min(c->votes + weight, RDS_MAX_VOTES);
+  else
+  {
+    c->cand  = ch;
+    c->votes = weight;
+  }
+
+  if(c->votes < RDS_VOTES || c->value == ch) return(false);
+  c->value = ch;
+  return(true);
+}
+
+static void rdsClearText(RdsChar *text, int len)
+{
+  memset(text, 0, len * sizeof(RdsChar));
+}
+
+static void rdsClear()
+{
+  rdsClearText(rdsPS, RDS_PS_LEN);
+  rdsClearText(rdsRT, RDS_RT_LEN);
+  rdsRTFlag  = 0xFF;
+  rdsRTLen   = RDS_RT_LEN;
+  rdsPI      = rdsPICand = 0;
+  rdsPIVotes = 0;
+  rdsPTY     = -1;
+  rdsPTYVotes = 0;
+  rdsTimeNew = false;
+  rdsAFCount = 0;
+  rdsQuality = 0;
+  memset(&rdsStats, 0, sizeof(rdsStats));
+}
+
+//
+// Forget everything about the current station (i.e. after retuning),
+// including groups still waiting in the FIFO
+//
+void rdsReset()
+{
+  rdsClear();
+  rdsFlush = true;
+}
+
+static bool rdsDecodePI(uint16_t pi, uint8_t weight)
+{
+  if(!weight) return(false);
+
+  if(pi == rdsPICand)
+    rdsPIVotes = min(rdsPIVotes + weight, RDS_MAX_VOTES);
+  else
+  {
+    rdsPICand  = pi;
+    rdsPIVotes = weight;
+  }
+
+  if(rdsPIVotes < RDS_VOTES || rdsPI == pi) return(false);
+
+  // Different station, drop whatever was decoded for the old one
+  if(rdsPI)
+  {
+    uint16_t votes = rdsPIVotes;
+    rdsClear();
+    rdsPICand  = pi;
+    rdsPIVotes = votes;
+  }
+
+  rdsPI = pi;
+  return(true);
+}
+
+static bool rdsDecodePTY(uint8_t pty, uint8_t weight)
+{
+  if(!weight) return(false);
+
+  if(pty == rdsPTYCand)
+    rdsPTYVotes = min(rdsPTYVotes + weight, RDS_MAX_VOTES);
+  else
+  {
+    rdsPTYCand  = pty;
+    rdsPTYVotes = weight;
+  }
+
+  if(rdsPTYVotes < RDS_VOTES || rdsPTY == pty) return(false);
+  rdsPTY = pty;
+  return(true);
+}
+
+static void rdsAddAF(uint8_t code)
+{
+  // Only FM frequencies (87.6 - 107.9 MHz), skip fillers
+  if(code < 1 || code > 204) return;
+
+  uint16_t freq = 8750 + code * 10;
+  for(int j=0 ; j<rdsAFCount ; j++)
+    if(rdsAF[j] == freq) return;
+
+  if(rdsAFCount < RDS_AF_MAX) rdsAF[rdsAFCount++] = freq;
+}
+
+//
+// Decode a pair of AF codes from group 0A (method A list)
+//
+static void rdsDecodeAF(uint8_t code1, uint8_t code2)
+{
+  uint8_t codes[2] = { code1, code2 };
+
+  for(int j=0 ; j<2 ; j++)
+  {
+    uint8_t code = codes[j];
+
+    // LF/MF frequency after code 250, not followed
+    if(rdsAFSkip)
+      rdsAFSkip = false;
+    // LF/MF frequency follows
+    else if(code == 250)
+      rdsAFSkip = true;
+    // Number of AFs in the list (224 + count)
+    else if(code >= 224 && code <= 249)
+      continue;
+    else
+      rdsAddAF(code);
+  }
+}
+
+static bool rdsDecodeTime(uint16_t c, uint16_t d)
+{
+  // Modified Julian day is ignored, only the time is used
+  int hours   = ((c & 1) << 4) | (d >> 12);
+  int minutes = (d >> 6) & 0x3F;
+  int offset  = (d & 0x1F) * 30 * ((d & 0x20)? -1 : 1);
+
+  if(hours > 23 || minutes > 59) return(false);
+
+  // Convert UTC to local time
+  int local = (hours * 60 + minutes + offset + 24 * 60) % (24 * 60);
+  rdsHours   = local / 60;
+  rdsMinutes = local % 60;
+  rdsTimeNew = true;
+  return(true);
+}
+
+//
+// Decode a single RDS group, returns true if decoded values changed
+//
+static bool rdsDecodeGroup(const uint16_t *block, const uint8_t *err)
+{
+  bool changed = false;
+
+  // Statistics
+  rdsStats.groups++;
+  for(int j=0 ; j<4 ; j++)
+  {
+    rdsStats.blocks++;
+    if(err[j] == RDS_ERR_BAD) rdsStats.blocksBad++;
+    else if(err[j] != RDS_ERR_NONE) rdsStats.blocksCorrected++;
+  }
+
+  // Share of usable blocks, averaged over about 16 groups
+  uint8_t usable = (err[0]<RDS_ERR_BAD) + (err[1]<RDS_ERR_BAD) + (err[2]<RDS_ERR_BAD) + (err[3]<RDS_ERR_BAD);
+  rdsQuality = rdsQuality - (rdsQuality >> 4) + ((usable * 25 * 256) >> 4);
+
+  changed |= rdsDecodePI(block[0], rdsWeight(err[0]));
+
+  // Can not tell what this group is without block B
+  if(err[1] == RDS_ERR_BAD) return(changed);
+
+  uint16_t b = block[1];
+  uint8_t type = b >> 12;
+  bool versionB = b & 0x0800;
+  uint8_t wb = rdsWeight(err[1]);
+
+  rdsStats.groupTypes[(b >> 11) & 0x1F]++;
+  changed |= rdsDecodePTY((b >> 5) & 0x1F, wb);
+
+  // Version B groups repeat PI in block C
+  if(versionB) changed |= rdsDecodePI(block[2], rdsWeight(err[2]));
+
+  switch(type)
+  {
+    case 0:
+      // Station name, two characters per group
+      {
+        uint8_t w = min(wb, rdsWeight(err[3]));
+        uint8_t pos = (b & 3) * 2;
+        changed |= rdsVote(&rdsPS[pos], block[3] >> 8, w);
+        changed |= rdsVote(&rdsPS[pos + 1], block[3] & 0xFF, w);
+      }
+
+      // Alternative frequencies
+      if(!versionB && err[1]<=1 && err[2]<=1)
+      {
+        rdsDecodeAF(block[2] >> 8, block[2] & 0xFF);
+      }
+      break;
+
+    case 2:
+      // Radio text, cleared when the A/B flag toggles
+      {
+        uint8_t flag = (b >> 4) & 1;
+        if(flag != rdsRTFlag)
+        {
+          if(rdsRTFlag != 0xFF) changed = true;
+          rdsClearText(rdsRT, RDS_RT_LEN);
+          rdsRTLen  = versionB? RDS_RT_LEN / 2 : RDS_RT_LEN;
+          rdsRTFlag = flag;
+        }
+
+        uint8_t pos = (b & 0x0F) * (versionB? 2 : 4);
+        uint8_t wd = min(wb, rdsWeight(err[3]));
+
+        if(!versionB)
+        {
+          uint8_t wc = min(wb, rdsWeight(err[2]));
+          changed |= rdsVote(&rdsRT[pos], block[2] >> 8, wc);
+          changed |= rdsVote(&rdsRT[pos + 1], block[2] & 0xFF, wc);
+          pos += 2;
+        }
+
+        changed |= rdsVote(&rdsRT[pos], block[3] >> 8, wd);
+        changed |= rdsVote(&rdsRT[pos + 1], block[3] & 0xFF, wd);
+      }
+      break;
+
+    case 4:
+      // Clock time, only taken from error-free groups
+      if(!versionB && !err[1] && !err[2] && !err[3])
+        changed |= rdsDecodeTime(block[2], block[3]);
+      break;
+  }
+
+  return(changed);
+}
+
+//
+// Drain the RDS FIFO, returns true if decoded values changed
+//
+bool rdsPoll()
+{
+  bool changed = false;
+
+  // Groups received before retuning belong to the old station
+  if(rdsFlush)
+  {
+    rx.getRdsGroup(true, true);
+    rdsFlush = false;
+    return(false);
+  }
+
+  // Acknowledge and check status without taking a group
+  const si47x_rds_status *st = rx.getRdsGroup(true);
+  if(st->resp.RDSSYNCLOST) rdsStats.syncLost++;
+
+  for(int n = min((int)st->resp.RDSFIFOUSED, RDS_FIFO_MAX) ; n>0 ; n--)
+  {
+    st = rx.getRdsGroup(false);
+    if(st->resp.GRPLOST) rdsStats.groupsLost++;
+
+    uint16_t block[4] =
+    {
+      (uint16_t)((st->resp.BLOCKAH << 8) | st->resp.BLOCKAL),
+      (uint16_t)((st->resp.BLOCKBH << 8) | st->resp.BLOCKBL),
+      (uint16_t)((st->resp.BLOCKCH << 8) | st->resp.BLOCKCL),
+      (uint16_t)((st->resp.BLOCKDH << 8) | st->resp.BLOCKDL)
+    };
+    uint8_t err[4] = { st->resp.BLEA, st->resp.BLEB, st->resp.BLEC, st->resp.BLED };
+
+    changed |= rdsDecodeGroup(block, err);
+  }
+
+  rdsStats.quality = rdsQuality >> 8;
+  return(changed);
+}
+
+//
+// Get confirmed PI code, or 0
+//
+uint16_t rdsGetPI()
+{
+  return(rdsPI);
+}
+
+//
+// Get confirmed program type, or -1
+//
+int rdsGetPTY()
+{
+  return(rdsPTY);
+}
+
+//
+// Get station name, or NULL until all characters are confirmed
+//
+const char *rdsGetPS()
+{
+  for(int j=0 ; j<RDS_PS_LEN ; j++)
+  {
+    if(!rdsPS[j].value) return(0);
+    rdsPSText[j] = rdsPS[j].value;
+  }
+
+  rdsPSText[RDS_PS_LEN] = '\0';
+  return(rdsPSText);
+}
+
+//
+// Get radio text, or NULL until all characters up to the end of the
+// text (0x0D) are confirmed
+//
+const char *rdsGetRT()
+{
+  int j;
+
+  for(j=0 ; j<rdsRTLen ; j++)
+  {
+    if(!rdsRT[j].value) return(0);
+    rdsRTText[j] = rdsRT[j].value;
+    if(rdsRT[j].value == 0x0D) break;
+  }
+
+  rdsRTText[j] = '\0';
+  return(rdsRTText);
+}
+
+//
+// Get clock time received since the last call, returns false if none
+//
+bool rdsGetTime(uint8_t *hours, uint8_t *minutes)
+{
+  if(!rdsTimeNew) return(false);
+
+  rdsTimeNew = false;
+  *hours   = rdsHours;
+  *minutes = rdsMinutes;
+  return(true);
+}
+
+//
+// Get alternative frequencies (10 kHz units), returns their number
+//
+uint8_t rdsGetAF(uint16_t *list, uint8_t max)
+{
+  uint8_t n = min(rdsAFCount, max);
+  memcpy(list, rdsAF, n * sizeof(uint16_t));
+  return(n);
+}
+
+//
+// Get decoder statistics for the current station
+//
+const RdsStats *rdsGetStats()
+{
+  return(&rdsStats);
+}
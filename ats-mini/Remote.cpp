@@ -3,10 +3,10 @@
 #include "Utils.h"
 #include "Menu.h"
 #include "Draw.h"
+#include "Af.h"
 
 static uint32_t remoteTimer = millis();
 static uint8_t remoteSeqnum = 0;
-static bool remoteLogOn = false;
 
 static uint8_t char2nibble(char key)
 {
@@ -17,111 +17,59 @@ static uint8_t char2nibble(char key)
 }
 
 //
-// Capture current screen image to the remote
+// Multi-character commands
+//
+// Command arguments are collected by remoteReceive() from whatever
+// input is available, so the main loop never waits for the host. Each
+// command ends with a terminator: numbers end at the first non-digit,
+// which is left in the input as the next command, lines end at CR/LF.
+// Incomplete commands are dropped after REMOTE_TIMEOUT of silence.
 //
-static void remoteCaptureScreen()
-{
-  uint16_t width  = spr.width();
-  uint16_t height = spr.height();
-
-  // 14 bytes of BMP header
-  Serial.println("");
-  Serial.print("424d"); // BM
-  // Image size
-  Serial.printf("%08x", (unsigned int)htonl(14 + 40 + 12 + width * height * 2));
-  Serial.print("00000000");
-  // Offset to image data
-  Serial.printf("%08x", (unsigned int)htonl(14 + 40 + 12));
-  // Image header
-  Serial.print("28000000"); // Header size
-  Serial.printf("%08x", (unsigned int)htonl(width));
-  Serial.printf("%08x", (unsigned int)htonl(height));
-  Serial.print("01001000"); // 1 plane, 16 bpp
-  Serial.print("03000000"); // Compression
-  Serial.print("00000000"); // Compressed image size
-  Serial.print("00000000"); // X res
-  Serial.print("00000000"); // Y res
-  Serial.print("00000000"); // Color map
-  Serial.print("00000000"); // Colors
-  Serial.print("00f80000"); // Red mask
-  Serial.print("e0070000"); // Green mask
-  Serial.println("1f000000"); // Blue mask
-
-  // Image data
-  for(int y=height-1 ; y>=0 ; y--)
-  {
-    for(int x=0 ; x<width ; x++)
-    {
-      Serial.printf("%04x", htons(spr.readPixel(x, y)));
-    }
-    Serial.println("");
-  }
-}
 
-char readSerialChar()
-{
-  char key;
+#define REMOTE_TIMEOUT  5000  // Drop incomplete commands after this (ms)
+#define REMOTE_MAX_ARGS 64    // Maximum argument length
 
-  while (!Serial.available());
-  key = Serial.read();
-  Serial.print(key);
-  return key;
-}
+#define REMOTE_PORTS    2     // Serial and BLE
 
-long int readSerialInteger()
+typedef struct
+{
+  Stream *port;                // Input and output stream
+  char cmd;                    // Command being received, or 0
+  char args[REMOTE_MAX_ARGS];  // Arguments received so far
+  uint16_t len;                // Argument length
+  uint32_t time;               // Last received byte time
+  bool skip;                   // TRUE: ignore input till newline
+  bool logOn;                  // TRUE: periodically print status
+} RemotePort;
+
+// Serial and BLE keep their own command state, commands are executed
+// with their output going to the port they came from
+static RemotePort remotePorts[REMOTE_PORTS];
+static RemotePort *remote = &remotePorts[REMOTE_SERIAL];
+
+static long int parseInteger(const char **p)
 {
   long int result = 0;
-  while (true) {
-    char ch = Serial.peek();
-    if (ch == 0xFF) {
-      continue;
-    } else if ((ch >= '0') && (ch <= '9')) {
-      ch = readSerialChar();
-      // Can overflow, but it's ok
-      result = result * 10 + (ch - '0');
-    } else {
-      return result;
-    }
-  }
+
+  // Can overflow, but it's ok
+  while((**p >= '0') && (**p <= '9')) result = result * 10 + (*(*p)++ - '0');
+  return(result);
 }
 
-void readSerialString(char *bufStr, uint8_t bufLen)
+static void parseString(const char **p, char *bufStr, uint8_t bufLen)
 {
   uint8_t length = 0;
-  while (true) {
-    char ch = Serial.peek();
-    if (ch == 0xFF) {
-      continue;
-    } else if (ch == ',' || ch < ' ') {
-      bufStr[length] = '\0';
-      return;
-    } else {
-      ch = readSerialChar();
-      bufStr[length] = ch;
-      if (++length >= bufLen - 1) {
-        bufStr[length] = '\0';
-        return;
-      }
-    }
-  }
-}
 
-static bool expectNewline()
-{
-  char ch;
-  while ((ch = Serial.peek()) == 0xFF);
-  if (ch == '\r') {
-    Serial.read();
-    return true;
-  }
-  return false;
+  while(**p && **p != ',' && **p >= ' ' && length < bufLen - 1)
+    bufStr[length++] = *(*p)++;
+  bufStr[length] = '\0';
 }
 
 static bool showError(const char *message)
 {
-  // Consume the remaining input
-  while (Serial.available()) readSerialChar();
-  Serial.printf("\r\nError: %s\r\n", message);
+  // Ignore the rest of the line
+  remote->skip = true;
+  remote->port->printf("\r\nError: %s\r\n", message);
   return false;
 }
 
@@ -129,7 +77,7 @@ static void remoteGetMemories()
 {
   for (uint8_t i = 0; i < getTotalMemories(); i++) {
     if (memories[i].freq) {
-      Serial.printf("#%03d,%s,%ld,%s,%s,%c\r\n",
+      remote->port->printf("#%03d,%s,%ld,%s,%s,%c\r\n",
         i + 1,
         bands[memories[i].band].bandName,
         memories[i].freq,
@@ -141,22 +89,21 @@ static void remoteGetMemories()
 }
 
 
-static bool remoteSetMemory()
+static bool remoteSetMemory(const char *p)
 {
-  Serial.print('#');
   Memory mem;
   memset(&mem, 0, sizeof(mem));
   uint32_t freq = 0;
 
-  long int slot = readSerialInteger();
-  if (readSerialChar() != ',')
+  long int slot = parseInteger(&p);
+  if (*p++ != ',')
     return showError("Expected ','");
   if (slot < 1 || slot > getTotalMemories())
     return showError("Invalid memory slot number");
 
   char band[8];
-  readSerialString(band, 8);
-  if (readSerialChar() != ',')
+  parseString(&p, band, 8);
+  if (*p++ != ',')
     return showError("Expected ','");
   mem.band = 0xFF;
   for (int i = 0; i < getTotalBands(); i++) {
@@ -168,32 +115,29 @@ static bool remoteSetMemory()
   if (mem.band == 0xFF)
     return showError("No such band");
 
-  freq = readSerialInteger();
-  char sep = readSerialChar();
-  if (sep != ',' && sep != '\r' && sep != '\n')
+  freq = parseInteger(&p);
+  if (*p && *p++ != ',')
     return showError("Expected ',' or newline");
 
   char mode[4];
-  readSerialString(mode, 4);
+  parseString(&p, mode, 4);
 
   // Check for optional name and favorite fields
-  char ch = Serial.peek();
-  if (ch == ',') {
-    readSerialChar(); // consume comma
-    readSerialString(mem.name, sizeof(mem.name));
-
-    ch = Serial.peek();
-    if (ch == ',') {
-      readSerialChar(); // consume comma
-      char favChar = readSerialChar();
+  if (*p == ',') {
+    p++; // consume comma
+    parseString(&p, mem.name, sizeof(mem.name));
+
+    if (*p == ',') {
+      p++; // consume comma
+      char favChar = *p ? *p++ : 0;
       if (favChar == 'Y' || favChar == 'y' || favChar == '1')
         mem.flags |= MEM_FLAG_FAVORITE;
     }
   }
 
-  if (!expectNewline())
+  if (*p)
     return showError("Expected newline");
-  Serial.println();
+  remote->port->println();
 
   mem.mode = 15;
   for (int i = 0; i < getTotalModes(); i++) {
@@ -233,36 +177,146 @@ static bool remoteSetMemory()
 }
 
 //
-// Set current color theme from the remote
+// Recall memory slot: *001 to *200
 //
-static void remoteSetColorTheme()
+static bool remoteRecallMemory(const char *p)
 {
-  Serial.print("Enter a string of hex colors (x0001x0002...): ");
+  long int slot = parseInteger(&p);
 
-  uint8_t *p = (uint8_t *)&(TH.bg);
+  if(slot < 1 || slot > getTotalMemories())
+  {
+    remote->port->println(" Invalid slot");
+    return false;
+  }
 
-  for(int i=0 ; ; i+=sizeof(uint16_t))
+  if(!recallMemorySlot(slot))
   {
-    if(i >= sizeof(ColorTheme)-offsetof(ColorTheme, bg))
-    {
-      Serial.println(" Ok");
-      break;
-    }
+    remote->port->printf("%ld Empty\r\n", slot);
+    return false;
+  }
 
-    if(readSerialChar() != 'x')
-    {
-      Serial.println(" Err");
+  Memory *m = &memories[slot-1];
+  if(m->name[0])
+    remote->port->printf("%ld OK %s\r\n", slot, m->name);
+  else
+    remote->port->printf("%ld OK\r\n", slot);
+  return true;
+}
+
+//
+// Direct frequency tune: F10650 (FM 106.50 MHz) or F7200 (AM 7200 kHz)
+//
+static bool remoteTuneFrequency(const char *p)
+{
+  long int freq = parseInteger(&p);
+  int result = tuneToFrequency(freq);
+
+  if(result == 0)
+  {
+    remote->port->printf("%ld OK\r\n", freq);
+    return true;
+  }
+  else if(result == 1)
+    remote->port->printf("%ld Error: 30-64 MHz not supported\r\n", freq);
+  else
+    remote->port->printf("%ld Error: Out of range\r\n", freq);
+
+  return false;
+}
+
+//
+// Direct parameter setting: =B,VHF =M,AM =S,100k =W,Auto =A,5
+//
+static bool remoteSetParameter(const char *p)
+{
+  char param = *p++;
+  char value[16];
+
+  if(*p++ != ',') return showError("Expected ','");
+  parseString(&p, value, sizeof(value));
+  remote->port->println();
+
+  int result = -1;
+  switch(param)
+  {
+    case 'B': // Band
+      result = setBandByName(value);
+      if(result >= 0)
+        remote->port->printf("Band=%s OK\r\n", value);
+      else
+        remote->port->printf("Band=%s Error: Not found\r\n", value);
+      break;
+    case 'M': // Mode
+      result = setModeByName(value);
+      if(result >= 0)
+        remote->port->printf("Mode=%s OK\r\n", value);
+      else
+        remote->port->printf("Mode=%s Error: Not valid for band\r\n", value);
+      break;
+    case 'S': // Step
+      result = setStepByName(value);
+      if(result >= 0)
+        remote->port->printf("Step=%s OK\r\n", value);
+      else
+        remote->port->printf("Step=%s Error: Not valid for mode\r\n", value);
+      break;
+    case 'W': // Bandwidth
+      result = setBandwidthByName(value);
+      if(result >= 0)
+        remote->port->printf("BW=%s OK\r\n", value);
+      else
+        remote->port->printf("BW=%s Error: Not valid for mode\r\n", value);
+      break;
+    case 'A': // AGC
+      {
+        int agcVal = atoi(value);
+        if(setAgcValue(agcVal))
+        {
+          remote->port->printf("AGC=%d OK\r\n", agcVal);
+          result = 0;
+        }
+        else
+          remote->port->printf("AGC=%d Error: Out of range (0-%d)\r\n", agcVal, getMaxAgc());
+      }
       break;
-    }
+    default:
+      remote->port->printf("%c Error: Unknown parameter\r\n", param);
+      break;
+  }
+
+  return(result >= 0);
+}
+
+//
+// Set current color theme from the remote, one character at a time,
+// returns TRUE when done
+//
+static bool remoteSetColorTheme(char key)
+{
+  uint8_t *p = (uint8_t *)&(TH.bg) + (remote->len / 5) * sizeof(uint16_t);
+  uint8_t nibble = char2nibble(key);
 
-    p[i + 1]  = char2nibble(readSerialChar()) * 16;
-    p[i + 1] |= char2nibble(readSerialChar());
-    p[i]      = char2nibble(readSerialChar()) * 16;
-    p[i]     |= char2nibble(readSerialChar());
+  switch(remote->len++ % 5)
+  {
+    case 0:
+      if(key == 'x') return(false);
+      remote->port->println(" Err");
+      drawScreen();
+      return(true);
+    case 1: p[1]  = nibble * 16; break;
+    case 2: p[1] |= nibble; break;
+    case 3: p[0]  = nibble * 16; break;
+    case 4: p[0] |= nibble; break;
   }
 
+  if(remote->len < (sizeof(ColorTheme)-offsetof(ColorTheme, bg)) / sizeof(uint16_t) * 5)
+    return(false);
+
+  remote->port->println(" Ok");
+
   // Redraw screen
   drawScreen();
+  return(true);
 }
 
 //
@@ -270,15 +324,41 @@ static void remoteSetColorTheme()
 //
 static void remoteGetColorTheme()
 {
-  Serial.printf("Color theme %s: ", TH.name);
+  remote->port->printf("Color theme %s: ", TH.name);
   const uint8_t *p = (uint8_t *)&(TH.bg);
 
   for(int i=0 ; i<sizeof(ColorTheme)-offsetof(ColorTheme, bg) ; i+=sizeof(uint16_t))
   {
-    Serial.printf("x%02X%02X", p[i+1], p[i]);
+    remote->port->printf("x%02X%02X", p[i+1], p[i]);
   }
 
-  Serial.println();
+  remote->port->println();
+}
+
+//
+// Print RDS decoder and AF statistics to the remote
+//
+static void remoteGetRdsStats()
+{
+  const RdsStats *st = rdsGetStats();
+
+  remote->port->printf("RDS PI %04X, quality %u%%\r\n", rdsGetPI(), st->quality);
+  remote->port->printf("Groups %lu, lost %lu, sync lost %lu\r\n",
+    (unsigned long)st->groups, (unsigned long)st->groupsLost, (unsigned long)st->syncLost);
+  remote->port->printf("Blocks %lu, corrected %lu, bad %lu\r\n",
+    (unsigned long)st->blocks, (unsigned long)st->blocksCorrected, (unsigned long)st->blocksBad);
+
+  // Only list group types that have been received
+  for(int j=0 ; j<32 ; j++)
+    if(st->groupTypes[j])
+      remote->port->printf("%d%c:%lu ", j >> 1, j & 1? 'B' : 'A', (unsigned long)st->groupTypes[j]);
+
+  remote->port->println();
+
+  const AfStats *af = afGetStats();
+  remote->port->printf("AF checks %lu, switches %lu, reverts %lu, gap %luus (max %luus), latency %lums\r\n",
+    (unsigned long)af->checks, (unsigned long)af->switches, (unsigned long)af->reverts,
+    (unsigned long)af->lastGap, (unsigned long)af->maxGap, (unsigned long)af->lastLatency);
 }
 
 //
@@ -287,19 +367,15 @@ static void remoteGetColorTheme()
 void remotePrintStatus()
 {
   // Prepare information ready to be sent
-  float remoteVoltage = batteryMonitor();
+  float remoteVoltage = telemetryVoltage() / 1000.0;
 
-  // S-Meter conditional on compile option
-  rx.getCurrentReceivedSignalQuality();
-  uint8_t remoteRssi = rx.getCurrentRSSI();
-  uint8_t remoteSnr = rx.getCurrentSNR();
-
-  // Use rx.getFrequency to force read of capacitor value from SI4732/5
-  rx.getFrequency();
-  uint16_t tuningCapacitor = rx.getAntennaTuningCapacitor();
+  // Take signal and capacitor from the shared sampler
+  uint8_t remoteRssi, remoteSnr;
+  telemetrySignal(&remoteRssi, &remoteSnr, TELEMETRY_MAX_AGE);
+  uint16_t tuningCapacitor = telemetryCapacitor(TELEMETRY_MAX_AGE);
 
   // Remote serial
-  Serial.printf("%uM,%u,%d,%d,%s,%s,%s,%s,%hu,%hu,%hu,%hu,%hu,%.2f,%hu,%hu,%s,%s\r\n",
+  remote->port->printf("%uM,%u,%d,%d,%s,%s,%s,%s,%hu,%hu,%hu,%hu,%hu,%.2f,%hu,%hu,%s,%s\r\n",
                 VER_APP,
                 currentFrequency,
                 currentBFO,
@@ -327,13 +403,32 @@ void remotePrintStatus()
 //
 void remoteTickTime()
 {
-  if(remoteLogOn && (millis() - remoteTimer >= 500))
+  bool printStatus = millis() - remoteTimer >= 500;
+
+  for(int j=0 ; j<REMOTE_PORTS ; j++)
+  {
+    remote = &remotePorts[j];
+    if(!remote->port) continue;
+
+    // Drop incomplete commands
+    if((remote->cmd || remote->skip) && (millis() - remote->time > REMOTE_TIMEOUT))
+    {
+      if(remote->cmd) remote->port->print("\r\nError: Timeout\r\n");
+      remote->cmd = 0;
+      remote->skip = false;
+    }
+
+    // Show status
+    if(remote->logOn && printStatus) remotePrintStatus();
+  }
+
+  remote = &remotePorts[REMOTE_SERIAL];
+
+  if(printStatus)
   {
     // Mark time and increment diagnostic sequence number
     remoteTimer = millis();
     remoteSeqnum++;
-    // Show status
-    remotePrintStatus();
   }
 }
 
@@ -428,169 +523,65 @@ int remoteDoCommand(char key)
       event |= REMOTE_PREFS;
       break;
     case 'C':
-      remoteLogOn = false;
-      remoteCaptureScreen();
+      remote->logOn = false;
+      captureSerial(false);
+      break;
+    case 'c':
+      remote->logOn = false;
+      captureSerial(true);
       break;
     case 't':
-      remoteLogOn = !remoteLogOn;
+      remote->logOn = !remote->logOn;
       break;
 
     case '$':
       remoteGetMemories();
       break;
-    case '#':
-      if (remoteSetMemory())
-        event |= REMOTE_PREFS;
+    case '&':
+      remoteGetRdsStats();
       break;
-    case '*':
-      // Recall memory slot: *001 to *200
-      {
-        Serial.print('*');
-        long int slot = readSerialInteger();
-        if(slot >= 1 && slot <= getTotalMemories())
-        {
-          if(recallMemorySlot(slot))
-          {
-            Memory *m = &memories[slot-1];
-            if(m->name[0])
-              Serial.printf("%ld OK %s\r\n", slot, m->name);
-            else
-              Serial.printf("%ld OK\r\n", slot);
-            event |= REMOTE_PREFS;
-          }
-          else
-            Serial.printf("%ld Empty\r\n", slot);
-        }
-        else
-          Serial.println(" Invalid slot");
-      }
-      break;
-
-    case 'F':
-      // Direct frequency tune: F10650 (FM 106.50 MHz) or F7200 (AM 7200 kHz)
-      {
-        Serial.print('F');
-        long int freq = readSerialInteger();
-        int result = tuneToFrequency(freq);
-        if(result == 0)
-        {
-          Serial.printf("%ld OK\r\n", freq);
-          event |= REMOTE_PREFS;
-        }
-        else if(result == 1)
-          Serial.printf("%ld Error: 30-64 MHz not supported\r\n", freq);
-        else
-          Serial.printf("%ld Error: Out of range\r\n", freq);
-      }
-      break;
-
-    case '=':
-      // Direct parameter setting: =B,VHF =M,AM =S,100k =W,Auto =A,5
-      {
-        Serial.print('=');
-        char param = readSerialChar();
-        if(readSerialChar() != ',')
-        {
-          showError("Expected ','");
-          break;
-        }
-        char value[16];
-        readSerialString(value, sizeof(value));
-        Serial.println();
-
-        int result = -1;
-        switch(param)
-        {
-          case 'B': // Band
-            result = setBandByName(value);
-            if(result >= 0)
-              Serial.printf("Band=%s OK\r\n", value);
-            else
-              Serial.printf("Band=%s Error: Not found\r\n", value);
-            break;
-          case 'M': // Mode
-            result = setModeByName(value);
-            if(result >= 0)
-              Serial.printf("Mode=%s OK\r\n", value);
-            else
-              Serial.printf("Mode=%s Error: Not valid for band\r\n", value);
-            break;
-          case 'S': // Step
-            result = setStepByName(value);
-            if(result >= 0)
-              Serial.printf("Step=%s OK\r\n", value);
-            else
-              Serial.printf("Step=%s Error: Not valid for mode\r\n", value);
-            break;
-          case 'W': // Bandwidth
-            result = setBandwidthByName(value);
-            if(result >= 0)
-              Serial.printf("BW=%s OK\r\n", value);
-            else
-              Serial.printf("BW=%s Error: Not valid for mode\r\n", value);
-            break;
-          case 'A': // AGC
-            {
-              int agcVal = atoi(value);
-              if(setAgcValue(agcVal))
-              {
-                Serial.printf("AGC=%d OK\r\n", agcVal);
-                result = 0;
-              }
-              else
-                Serial.printf("AGC=%d Error: Out of range (0-%d)\r\n", agcVal, getMaxAgc());
-            }
-            break;
-          default:
-            Serial.printf("%c Error: Unknown parameter\r\n", param);
-            break;
-        }
-        if(result >= 0) event |= REMOTE_PREFS;
-      }
-      break;
-
     case '?':
       // List available options for current state
       {
-        Serial.println("\r\nAvailable options:");
-        Serial.print("Bands: ");
+        remote->port->println("\r\nAvailable options:");
+        remote->port->print("Bands: ");
         for(int i = 0; i < getTotalBands(); i++)
         {
-          if(i > 0) Serial.print(",");
-          Serial.print(bands[i].bandName);
+          if(i > 0) remote->port->print(",");
+          remote->port->print(bands[i].bandName);
         }
-        Serial.printf(" [current: %s]\r\n", getCurrentBand()->bandName);
+        remote->port->printf(" [current: %s]\r\n", getCurrentBand()->bandName);
 
-        Serial.print("Modes: ");
+        remote->port->print("Modes: ");
         bool first = true;
         for(int i = 0; i < getTotalModes(); i++)
         {
           if(isModeValidForBand(i))
           {
-            if(!first) Serial.print(",");
-            Serial.print(bandModeDesc[i]);
+            if(!first) remote->port->print(",");
+            remote->port->print(bandModeDesc[i]);
             first = false;
           }
         }
-        Serial.printf(" [current: %s]\r\n", bandModeDesc[currentMode]);
+        remote->port->printf(" [current: %s]\r\n", bandModeDesc[currentMode]);
 
-        Serial.print("Steps: ");
+        remote->port->print("Steps: ");
         for(int i = 0; i < getStepsCount(); i++)
         {
-          if(i > 0) Serial.print(",");
-          Serial.print(getStepDesc(i));
+          if(i > 0) remote->port->print(",");
+          remote->port->print(getStepDesc(i));
         }
-        Serial.printf(" [current: %s]\r\n", getCurrentStep()->desc);
+        remote->port->printf(" [current: %s]\r\n", getCurrentStep()->desc);
 
-        Serial.print("BW: ");
+        remote->port->print("BW: ");
         for(int i = 0; i < getBandwidthsCount(); i++)
         {
-          if(i > 0) Serial.print(",");
-          Serial.print(getBandwidthDesc(i));
+          if(i > 0) remote->port->print(",");
+          remote->port->print(getBandwidthDesc(i));
         }
-        Serial.printf(" [current: %s]\r\n", getCurrentBandwidth()->desc);
+        remote->port->printf(" [current: %s]\r\n", getCurrentBandwidth()->desc);
 
-        Serial.printf("AGC: 0-%d [current: %d]\r\n", getMaxAgc(), getCurrentAgc());
+        remote->port->printf("AGC: 0-%d [current: %d]\r\n", getMaxAgc(), getCurrentAgc());
       }
       break;
 
@@ -598,44 +589,41 @@ int remoteDoCommand(char key)
       // Output dropdown rules in compact machine-parseable format
       // Format: RULES|bands|band_types|mode_rules|step_rules|bw_rules|agc_rules
       {
-        Serial.print("RULES|");
+        remote->port->print("RULES|");
 
         // All bands with their types (F=FM, M=MW, S=SW, L=LW)
         for(int i = 0; i < getTotalBands(); i++)
         {
-          if(i > 0) Serial.print(",");
-          Serial.print(bands[i].bandName);
-          Serial.print(":");
+          if(i > 0) remote->port->print(",");
+          remote->port->print(bands[i].bandName);
+          remote->port->print(":");
           switch(bands[i].bandType)
           {
-            case FM_BAND_TYPE: Serial.print("F"); break;
-            case MW_BAND_TYPE: Serial.print("M"); break;
-            case SW_BAND_TYPE: Serial.print("S"); break;
-            case LW_BAND_TYPE: Serial.print("L"); break;
+            case FM_BAND_TYPE: remote->port->print("F"); break;
+            case MW_BAND_TYPE: remote->port->print("M"); break;
+            case SW_BAND_TYPE: remote->port->print("S"); break;
+            case LW_BAND_TYPE: remote->port->print("L"); break;
           }
         }
 
         // Mode rules: F=FM only, other types=AM,LSB,USB
-        Serial.print("|F:FM;M:AM,LSB,USB;S:AM,LSB,USB;L:AM,LSB,USB");
+        remote->port->print("|F:FM;M:AM,LSB,USB;S:AM,LSB,USB;L:AM,LSB,USB");
 
         // Steps per mode (static lists from Menu.cpp arrays)
-        Serial.print("|FM:10k,50k,100k,200k,1M;SSB:10,25,50,100,500,1k,5k,9k,10k;AM:1k,5k,9k,10k,50k,100k,1M");
+        remote->port->print("|FM:10k,50k,100k,200k,1M;SSB:10,25,50,100,500,1k,5k,9k,10k;AM:1k,5k,9k,10k,50k,100k,1M");
 
         // Bandwidths per mode
-        Serial.print("|FM:Auto,110k,84k,60k,40k;SSB:0.5k,1.0k,1.2k,2.2k,3.0k,4.0k;AM:1.0k,1.8k,2.0k,2.5k,3.0k,4.0k,6.0k");
+        remote->port->print("|FM:Auto,110k,84k,60k,40k;SSB:0.5k,1.0k,1.2k,2.2k,3.0k,4.0k;AM:1.0k,1.8k,2.0k,2.5k,3.0k,4.0k,6.0k");
 
         // AGC max per mode
-        Serial.print("|FM:27;SSB:1;AM:37");
+        remote->port->print("|FM:27;SSB:1;AM:37");
 
-        Serial.println();
+        remote->port->println();
       }
       break;
 
     case 'T':
-      Serial.println(switchThemeEditor(!switchThemeEditor()) ? "Theme editor enabled" : "Theme editor disabled");
-      break;
-    case '!':
-      if(switchThemeEditor()) remoteSetColorTheme();
+      remote->port->println(switchThemeEditor(!switchThemeEditor()) ? "Theme editor enabled" : "Theme editor disabled");
       break;
     case '@':
       if(switchThemeEditor()) remoteGetColorTheme();
@@ -649,3 +637,151 @@ int remoteDoCommand(char key)
   // Command recognized
   return(event | REMOTE_CHANGED);
 }
+
+//
+// Execute collected multi-character command, returns REMOTE_* events
+//
+static int remoteFinish()
+{
+  int event = REMOTE_CHANGED;
+
+  remote->args[remote->len] = '\0';
+
+  switch(remote->cmd)
+  {
+    case '#':
+      if(remoteSetMemory(remote->args)) event |= REMOTE_PREFS;
+      // Whole line has been received already
+      remote->skip = false;
+      break;
+    case '*':
+      if(remoteRecallMemory(remote->args)) event |= REMOTE_PREFS;
+      break;
+    case 'F':
+      if(remoteTuneFrequency(remote->args)) event |= REMOTE_PREFS;
+      break;
+    case '=':
+      if(remoteSetParameter(remote->args)) event |= REMOTE_PREFS;
+      break;
+    case '%':
+      remote->port->println();
+      if(!telemetryConfigure(remote==&remotePorts[REMOTE_BLE]? TELEMETRY_BLE : TELEMETRY_SERIAL, remote->args))
+        showError("Invalid subscription");
+      remote->skip = false;
+      break;
+  }
+
+  remote->cmd = 0;
+  return(event);
+}
+
+//
+// Receive available input from the current port, executing complete
+// commands, returns REMOTE_* events
+//
+static int remoteReceivePort()
+{
+  while(remote->port->available() > 0)
+  {
+    // Binary protocol frames are handled separately
+    if(!remote->cmd && remote==&remotePorts[REMOTE_SERIAL] && protoIsPending())
+    {
+      remote->skip = false;
+      return(protoReceive());
+    }
+
+    char key = remote->port->peek();
+    remote->time = millis();
+
+    // Ignore the rest of a bad line
+    if(remote->skip)
+    {
+      remote->port->read();
+      remote->skip = key != '\r' && key != '\n';
+      continue;
+    }
+
+    // Start a new command
+    if(!remote->cmd)
+    {
+      remote->port->read();
+      switch(key)
+      {
+        case '!':
+          if(!switchThemeEditor()) return(REMOTE_CHANGED);
+          remote->port->print("Enter a string of hex colors (x0001x0002...): ");
+          break;
+        case '#':
+        case '*':
+        case 'F':
+        case '=':
+        case '%':
+          remote->port->print(key);
+          break;
+        default:
+          {
+            // Skip unknown characters, such as line ends
+            int event = remoteDoCommand(key);
+            if(event) return(event);
+          }
+          continue;
+      }
+
+      remote->cmd = key;
+      remote->len = 0;
+      continue;
+    }
+
+    if(remote->cmd == '!')
+    {
+      remote->port->print((char)remote->port->read());
+      if(!remoteSetColorTheme(key)) continue;
+      remote->cmd = 0;
+      return(REMOTE_CHANGED);
+    }
+
+    // Numbers and values end before the terminator, which is
+    // left in the input as the next command
+    if(((remote->cmd == '*' || remote->cmd == 'F') && (key < '0' || key > '9')) ||
+       (remote->cmd == '=' && remote->len >= 2 && (key == ',' || key < ' ')))
+      return(remoteFinish());
+
+    // Lines end with the newline
+    remote->port->read();
+    if((remote->cmd == '#' || remote->cmd == '%') && (key == '\r' || key == '\n'))
+      return(remoteFinish());
+
+    if(remote->len >= REMOTE_MAX_ARGS - 1)
+    {
+      remote->cmd = 0;
+      showError("Command too long");
+      return(REMOTE_CHANGED);
+    }
+
+    remote->port->print(key);
+    remote->args[remote->len++] = key;
+
+    // Parameter name must be followed by a comma
+    if(remote->cmd == '=' && remote->len == 2 && key != ',')
+      return(remoteFinish());
+  }
+
+  return(0);
+}
+
+//
+// Receive available serial or BLE input, executing complete commands
+// Returns REMOTE_* events
+//
+int remoteReceive(uint8_t source)
+{
+  if(source >= REMOTE_PORTS) return(0);
+
+  remote = &remotePorts[source];
+  remote->port = source==REMOTE_BLE? bleStream() : &Serial;
+  int event = remoteReceivePort();
+
+  // Queued commands report to the serial port
+  remote = &remotePorts[REMOTE_SERIAL];
+  return(event);
+}
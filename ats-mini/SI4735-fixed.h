@@ -1,5 +1,32 @@
 #include <SI4735.h>
 
+#define PATCH_CTS_POLLS 100  // Maximum CTS polls per patch command
+#define PATCH_CTS_WAIT  10   // Delay between CTS polls (us)
+
+#define SHADOW_SIZE     24   // Maximum number of shadowed settings
+#define TUNE_POLL_WAIT  2    // Delay between tuning status polls (ms)
+
+// Shadowed SI4735 properties
+#define PROP_FM_DEEMPHASIS        0x1100
+#define PROP_FM_SEEK_BOTTOM       0x1400
+#define PROP_FM_SEEK_TOP          0x1401
+#define PROP_FM_SEEK_SPACING      0x1402
+#define PROP_FM_SEEK_SNR          0x1403
+#define PROP_FM_SEEK_RSSI         0x1404
+#define PROP_RDS_CONFIG           0x1502
+#define PROP_AM_AVC_MAX_GAIN      0x3103
+#define PROP_AM_SOFT_MUTE_MAX_ATT 0x3302
+#define PROP_AM_SEEK_BOTTOM       0x3400
+#define PROP_AM_SEEK_TOP          0x3401
+#define PROP_AM_SEEK_SPACING      0x3402
+#define PROP_AM_SEEK_SNR          0x3403
+#define PROP_AM_SEEK_RSSI         0x3404
+
+// Shadowed SI4735 commands (not real property numbers)
+#define SHADOW_GPIO_CTL           0xFF80
+#define SHADOW_GPIO_SET           0xFF81
+#define SHADOW_AGC_OVERRIDE       0xFF82
+
 class SI4735_fixed: public SI4735
 {
   public:
@@ -31,6 +58,14 @@ class SI4735_fixed: public SI4735
       return getRdsVersionCode()? SI4735::getRdsText2B() : NULL;
     }
 
+    // Read RDS status, taking the oldest group from the FIFO unless
+    // statusOnly is set, and acknowledge RDS interrupts
+    const si47x_rds_status *getRdsGroup(bool statusOnly, bool flush = false)
+    {
+      getRdsStatus(1, flush, statusOnly);
+      return &currentRdsStatus;
+    }
+
     // Only one kind of text is available
     inline char *getRdsProgramInformation(void)
     {
@@ -43,63 +78,263 @@ class SI4735_fixed: public SI4735
       return getRdsVersionCode()? SI4735::getRdsText2B() : SI4735::getRdsText2A();
     }
 
-  void seekStationProgress(void (*showFunc)(uint16_t f), bool (*stopSeeking)(), uint8_t up_down)
-  {
-    si47x_frequency freq;
-    long elapsed_seek = millis();
+    //
+    // Incremental seek
+    //
+    // Instead of SI4735::seekStationProgress() busy looping until a
+    // station is found, the seek is started by seekStationStart() and
+    // then polled by seekStationPoll() from the main loop, as often as
+    // the caller wants, so that the rest of the firmware keeps running.
+    //
 
-    // seek command does not work for SSB
-    if (lastMode == SSB_CURRENT_MODE)
-      return;
+    // Start seeking up (1) or down (0), returns false if not possible
+    bool seekStationStart(uint8_t up_down)
+    {
+      // Seek command does not work for SSB
+      if(lastMode == SSB_CURRENT_MODE) return false;
+
+      seekStation(up_down, 0);
+      return true;
+    }
 
-    seekStation(up_down, 0);
-    do
+    // Get frequency the chip is seeking at, returns false once the
+    // seek is complete (station found or band limit reached)
+    bool seekStationPoll(uint16_t *freq)
     {
-      delay(maxDelaySetFrequency);
+      si47x_frequency f;
+
       getStatus(0, 0);
-      delay(maxDelaySetFrequency);
-      freq.raw.FREQH = currentStatus.resp.READFREQH;
-      freq.raw.FREQL = currentStatus.resp.READFREQL;
-      currentWorkFrequency = freq.value;
-      if (showFunc != NULL)
-        showFunc(freq.value);
-      if (stopSeeking != NULL)
-        if (stopSeeking())
-          return;
-
-    } while (!currentStatus.resp.VALID && !currentStatus.resp.BLTF && (millis() - elapsed_seek) < maxSeekTime);
-  }
-
-#if 0
-    // Speeding up SI4735::downloadPatch() function
-    bool downloadPatch(const uint8_t *ssb_patch_content, const uint16_t ssb_patch_content_size)
-    {
-      for(uint16_t offset=0 ; offset<ssb_patch_content_size ; offset+=8)
+      f.raw.FREQH = currentStatus.resp.READFREQH;
+      f.raw.FREQL = currentStatus.resp.READFREQL;
+      currentWorkFrequency = f.value;
+      if(freq) *freq = f.value;
+
+      return !currentStatus.resp.VALID && !currentStatus.resp.BLTF;
+    }
+
+    // Stop seeking, the chip stays at the current frequency
+    void seekStationCancel(void)
+    {
+      getStatus(1, 1);
+    }
+
+    //
+    // Settings shadow
+    //
+    // useBand() and the menu handlers set the same properties over and
+    // over again. The last value written through the setters below is
+    // remembered, so that writing the same value again costs no I2C
+    // traffic. Powering the chip up resets all properties, so the
+    // shadow is cleared whenever setFM()/setAM()/setSSB() or the SSB
+    // patch loader may power the chip up.
+    //
+
+    // Clear all shadowed values
+    void shadowReset(void)
+    {
+      shadowCount = 0;
+    }
+
+    // Returns true if the value is already set, otherwise remembers it
+    bool shadowMatch(uint16_t key, uint16_t value)
+    {
+      for(int j=0 ; j<shadowCount ; j++)
       {
-        Wire.beginTransmission(deviceAddress);
+        if(shadowKey[j]!=key) continue;
+        if(shadowValue[j]==value) return true;
+        shadowValue[j] = value;
+        return false;
+      }
+
+      if(shadowCount<SHADOW_SIZE)
+      {
+        shadowKey[shadowCount] = key;
+        shadowValue[shadowCount++] = value;
+      }
+
+      return false;
+    }
+
+    using SI4735::setFM;
+    using SI4735::setAM;
+    using SI4735::setSSB;
+
+    // Always powers the chip up
+    void setFM(uint16_t fromFreq, uint16_t toFreq, uint16_t initialFreq, uint16_t step)
+    {
+      shadowReset();
+      SI4735::setFM(fromFreq, toFreq, initialFreq, step);
+    }
+
+    // Powers the chip up when switching from another mode
+    void setAM(uint16_t fromFreq, uint16_t toFreq, uint16_t initialFreq, uint16_t step)
+    {
+      if(lastMode!=AM_CURRENT_MODE) shadowReset();
+      SI4735::setAM(fromFreq, toFreq, initialFreq, step);
+    }
+
+    // Powers the chip up when switching from another mode
+    void setSSB(uint16_t fromFreq, uint16_t toFreq, uint16_t initialFreq, uint16_t step, uint8_t usblsb)
+    {
+      if(lastMode!=SSB_CURRENT_MODE) shadowReset();
+      SI4735::setSSB(fromFreq, toFreq, initialFreq, step, usblsb);
+    }
+
+    void setSeekFmLimits(uint16_t bottom, uint16_t top)
+    {
+      // Not short-circuited, both values have to be remembered
+      if(shadowMatch(PROP_FM_SEEK_BOTTOM, bottom) & shadowMatch(PROP_FM_SEEK_TOP, top)) return;
+      SI4735::setSeekFmLimits(bottom, top);
+    }
+
+    void setSeekAmLimits(uint16_t bottom, uint16_t top)
+    {
+      // Not short-circuited, both values have to be remembered
+      if(shadowMatch(PROP_AM_SEEK_BOTTOM, bottom) & shadowMatch(PROP_AM_SEEK_TOP, top)) return;
+      SI4735::setSeekAmLimits(bottom, top);
+    }
+
+    void setSeekFmSpacing(uint16_t spacing)
+    {
+      if(!shadowMatch(PROP_FM_SEEK_SPACING, spacing)) SI4735::setSeekFmSpacing(spacing);
+    }
+
+    void setSeekAmSpacing(uint16_t spacing)
+    {
+      if(!shadowMatch(PROP_AM_SEEK_SPACING, spacing)) SI4735::setSeekAmSpacing(spacing);
+    }
+
+    void setSeekFmRssiThreshold(uint16_t value)
+    {
+      if(!shadowMatch(PROP_FM_SEEK_RSSI, value)) SI4735::setSeekFmRssiThreshold(value);
+    }
+
+    void setSeekFmSNRThreshold(uint16_t value)
+    {
+      if(!shadowMatch(PROP_FM_SEEK_SNR, value)) SI4735::setSeekFmSNRThreshold(value);
+    }
+
+    void setSeekAmRssiThreshold(uint16_t value)
+    {
+      if(!shadowMatch(PROP_AM_SEEK_RSSI, value)) SI4735::setSeekAmRssiThreshold(value);
+    }
 
-        for(uint16_t i=0 ; i<8 ; i++)
-          Wire.write(pgm_read_byte_near(ssb_patch_content + (i + offset)));
+    void setSeekAmSNRThreshold(uint16_t value)
+    {
+      if(!shadowMatch(PROP_AM_SEEK_SNR, value)) SI4735::setSeekAmSNRThreshold(value);
+    }
 
-        Wire.endTransmission();
-        waitToSend();
+    void setFMDeEmphasis(uint8_t parameter)
+    {
+      if(!shadowMatch(PROP_FM_DEEMPHASIS, parameter)) SI4735::setFMDeEmphasis(parameter);
+    }
+
+    void setRdsConfig(uint8_t RDSEN, uint8_t BLETHA, uint8_t BLETHB, uint8_t BLETHC, uint8_t BLETHD)
+    {
+      uint16_t value = RDSEN | (BLETHD << 8) | (BLETHC << 10) | (BLETHB << 12) | (BLETHA << 14);
+      if(!shadowMatch(PROP_RDS_CONFIG, value)) SI4735::setRdsConfig(RDSEN, BLETHA, BLETHB, BLETHC, BLETHD);
+    }
+
+    void setAmSoftMuteMaxAttenuation(uint8_t smattn)
+    {
+      if(!shadowMatch(PROP_AM_SOFT_MUTE_MAX_ATT, smattn)) SI4735::setAmSoftMuteMaxAttenuation(smattn);
+    }
+
+    void setAvcAmMaxGain(uint8_t gain)
+    {
+      if(!shadowMatch(PROP_AM_AVC_MAX_GAIN, gain)) SI4735::setAvcAmMaxGain(gain);
+    }
+
+    void setGpioCtl(uint8_t GPO1OEN, uint8_t GPO2OEN, uint8_t GPO3OEN)
+    {
+      if(!shadowMatch(SHADOW_GPIO_CTL, GPO1OEN | (GPO2OEN << 1) | (GPO3OEN << 2)))
+        SI4735::setGpioCtl(GPO1OEN, GPO2OEN, GPO3OEN);
+    }
+
+    void setGpio(uint8_t GPO1LEVEL, uint8_t GPO2LEVEL, uint8_t GPO3LEVEL)
+    {
+      if(!shadowMatch(SHADOW_GPIO_SET, GPO1LEVEL | (GPO2LEVEL << 1) | (GPO3LEVEL << 2)))
+        SI4735::setGpio(GPO1LEVEL, GPO2LEVEL, GPO3LEVEL);
+    }
+
+    void setAutomaticGainControl(uint8_t AGCDIS, uint8_t AGCIDX)
+    {
+      if(!shadowMatch(SHADOW_AGC_OVERRIDE, (AGCDIS << 8) | AGCIDX))
+        SI4735::setAutomaticGainControl(AGCDIS, AGCIDX);
+    }
+
+    // Wait until tuning completes, returns false on timeout
+    bool waitTuneComplete(uint16_t timeout)
+    {
+      for(uint32_t start=millis() ; ; delay(TUNE_POLL_WAIT))
+      {
+        getStatus(0, 0);
+        if(getTuneCompleteTriggered()) return true;
+        if((millis() - start) >= timeout) return false;
+      }
+    }
+
+    // Resets the chip
+    void loadPatch(const uint8_t *ssb_patch_content, const uint16_t ssb_patch_content_size, uint8_t ssb_audiobw = 1)
+    {
+      shadowReset();
+      SI4735::loadPatch(ssb_patch_content, ssb_patch_content_size, ssb_audiobw);
+    }
+
+    // Faster replacement for SI4735::downloadPatch(). Every patch line
+    // is a single 8-byte command, sent in one I2C write, and the next
+    // one follows as soon as the chip reports CTS, instead of after a
+    // fixed 300us delay. Returns false if the chip reports an error or
+    // stops responding, so that the patch is never silently truncated.
+    bool downloadPatchFast(const uint8_t *patch, uint16_t size)
+    {
+      for(uint16_t offset=0 ; offset<size ; offset+=8)
+      {
+        Wire.beginTransmission(deviceAddress);
+        Wire.write(patch + offset, min(8, size - offset));
+        if(Wire.endTransmission() || !waitPatchCts()) return false;
       }
 
-      delayMicroseconds(250);
       return true;
     }
 
-    // Using the new downloadPatch() function here
-    void loadPatch(const uint8_t *ssb_patch_content, const uint16_t ssb_patch_content_size, uint8_t ssb_audiobw)
+    // Wait for the chip to accept the next command, false on error
+    bool waitPatchCts(void)
     {
-      queryLibraryId();                                                                                                       patchPowerUp();
-      delay(50);                                                                                                              downloadPatch(ssb_patch_content, ssb_patch_content_size);                                                               // Parameters                                                                                                           // AUDIOBW - SSB Audio bandwidth; 0 = 1.2kHz (default); 1=2.2kHz; 2=3kHz; 3=4kHz; 4=500Hz; 5=1kHz;
-      // SBCUTFLT SSB - side band cutoff filter for band passand low pass filter ( 0 or 1)                                    // AVC_DIVIDER  - set 0 for SSB mode; set 3 for SYNC mode.
-      // AVCEN - SSB Automatic Volume Control (AVC) enable; 0=disable; 1=enable (default).
-      // SMUTESEL - SSB Soft-mute Based on RSSI or SNR (0 or 1).
-      // DSP_AFCDIS - DSP AFC Disable or enable; 0=SYNC MODE, AFC enable; 1=SSB MODE, AFC disable.
+      for(int j=0 ; j<PATCH_CTS_POLLS ; j++)
+      {
+        if(Wire.requestFrom((uint8_t)deviceAddress, (uint8_t)1)==1)
+        {
+          uint8_t status = Wire.read();
+          if(status & 0x40) return false;  // ERR
+          if(status & 0x80) return true;   // CTS
+        }
+
+        delayMicroseconds(PATCH_CTS_WAIT);
+      }
+
+      return false;
+    }
+
+    // Same as SI4735::loadPatch(), using downloadPatchFast()
+    bool loadPatchFast(const uint8_t *patch, uint16_t size, uint8_t ssb_audiobw)
+    {
+      shadowReset();
+      queryLibraryId();
+      patchPowerUp();
+      delay(50);
+
+      if(!downloadPatchFast(patch, size)) return false;
+
+      // AUDIOBW, SBCUTFLT, AVC_DIVIDER, AVCEN, SMUTESEL, DSP_AFCDIS
+      // (see SI4735::loadPatch())
       setSSBConfig(ssb_audiobw, 1, 0, 0, 0, 1);
       delay(25);
+      return true;
     }
-#endif
+
+  private:
+    uint16_t shadowKey[SHADOW_SIZE];
+    uint16_t shadowValue[SHADOW_SIZE];
+    uint8_t shadowCount = 0;
 };
@@ -11,6 +11,9 @@
 #define SCAN_POINTS      1700 // Maximum frequencies per scan (full resolution for any band)
 #define SCAN_POOL_SIZE   2000 // Shared pool for cached bands (~4KB, LRU managed)
 #define MAX_BANDS          40 // Maximum number of bands for per-band cache metadata
+#define SCAN_SEEK_AGE  3600000 // Maximum age of a scan used for seeking (msecs)
+#define SCAN_PEAK_MARGIN    6 // Station must be this much above the noise floor (dB)
+#define SCAN_FLOOR_RISE     4 // Noise floor rises by 1/2^N of the difference per point
 
 // Sparse scan constants (for ALL band only)
 #define SPARSE_MAX_POINTS  SCAN_POINTS // Max sparse points (same as dense buffer: 1700)
@@ -62,6 +65,7 @@ typedef struct
   bool     valid;
   uint16_t poolOffset;  // Offset into shared scanPool
   uint32_t lastUsed;    // Timestamp for LRU eviction
+  uint32_t scanned;     // Scan timestamp (0 = unknown, e.g. loaded from storage)
 } BandScanCache;
 
 // Current scan data (working buffer for active scanning)
@@ -87,6 +91,9 @@ static BandScanCache bandScanCache[MAX_BANDS];
 
 static uint32_t scanTime = millis();
 static uint8_t  scanStatus = SCAN_OFF;
+static uint32_t scanVersion = 0;        // Incremented on every scan data change
+static uint32_t scanEpoch = 0;          // Incremented unless data has only been appended
+static int8_t   scanLoadedBand = -1;    // Band whose cache matches scanData[]
 
 static uint16_t scanStartFreq;
 static uint16_t scanStep;
@@ -100,13 +107,63 @@ static uint8_t  scanMaxSNR;
 static uint16_t scanSavedFreq = 0;
 static uint16_t scanMaxPoints = SCAN_POINTS;
 
+// Stations found in scanData[], see scanPeaksUpdate()
+static ScanPeak scanPeaks[SCAN_PEAKS];
+static uint8_t  scanPeakCount = 0;
+static uint32_t scanPeakTime = 0;       // Time scanData[] was scanned (0 = unknown)
+static uint16_t scanPeakNext = 0;       // Next scanData[] point to examine
+static uint16_t scanPeakFloor = 0;      // Smoothed noise floor (1/16 dB units)
+static uint16_t scanPeakStart = 0;      // First point of the open peak
+static uint32_t scanPeakWeight = 0;     // Total weight of the open peak (0 = none)
+static uint32_t scanPeakMoment = 0;     // Weighted offsets of the open peak
+static uint8_t  scanPeakRSSI = 0;       // Strongest RSSI of the open peak
+static uint16_t scanPeakBest = 0;       // Strongest point of the open peak
+static uint8_t  scanPeakSNR = 0;        // Best SNR of the open peak
+
+// Copy of the station list for other tasks, see scanCopyPeaks()
+typedef struct
+{
+  int8_t   band;                        // Band stations belong to (-1 = none)
+  uint8_t  count;                       // Number of stations
+  uint32_t time;                        // Time band was scanned at (0 = unknown)
+  ScanPeak peaks[SCAN_PEAKS];
+} ScanPeakList;
+
+static portMUX_TYPE scanPeakLock = portMUX_INITIALIZER_UNLOCKED;
+static ScanPeakList scanPeakShared = { -1 };
+
 static inline uint8_t min(uint8_t a, uint8_t b) { return(a<b? a:b); }
 static inline uint8_t max(uint8_t a, uint8_t b) { return(a>b? a:b); }
 
 // Forward declaration for sparse scan expansion
 static void expandSparseToDense(bool live = false);
+static void scanPeaksUpdate();
+static void scanPeaksPublish();
 
-float scanGetRSSI(uint16_t freq)
+// Mark scan data as changed (and no longer matching any band cache)
+// Unless a point has just been appended, stations are found again
+static inline void scanChanged(bool appended = false)
+{
+  scanVersion++;
+  scanLoadedBand = -1;
+
+  if(!appended)
+  {
+    scanEpoch++;
+    scanPeakCount  = 0;
+    scanPeakNext   = 0;
+    scanPeakWeight = 0;
+    scanPeakTime   = millis();
+  }
+
+  scanPeaksUpdate();
+  scanPeaksPublish();
+}
+
+//
+// Get scanData[] index for given frequency, or -1 if there is no data
+//
+static int scanGetIndex(uint16_t freq)
 {
   // Determine effective step (use display step during SCAN_SPARSE)
   uint16_t effectiveStep = (scanStatus == SCAN_SPARSE && sparseDisplayStep > 0) ? sparseDisplayStep : scanStep;
@@ -114,9 +171,17 @@ float scanGetRSSI(uint16_t freq)
   // Input frequency must be in range of existing data (allow during SCAN_RADIO/SCAN_SPARSE for progressive display)
   if((scanStatus!=SCAN_DONE && scanStatus!=SCAN_RADIO && scanStatus!=SCAN_SPARSE) ||
      (freq<scanStartFreq) || (freq>=scanStartFreq+effectiveStep*scanCount))
-    return(0.0);
+    return(-1);
 
-  uint8_t result = scanData[(freq - scanStartFreq) / effectiveStep].rssi;
+  return((freq - scanStartFreq) / effectiveStep);
+}
+
+float scanGetRSSI(uint16_t freq)
+{
+  int idx = scanGetIndex(freq);
+  if(idx < 0) return(0.0);
+
+  uint8_t result = scanData[idx].rssi;
   // Avoid division by zero if range is 0
   if(scanMaxRSSI <= scanMinRSSI) return 0.5;
   return((result - scanMinRSSI) / (float)(scanMaxRSSI - scanMinRSSI + 1));
@@ -124,20 +189,130 @@ float scanGetRSSI(uint16_t freq)
 
 float scanGetSNR(uint16_t freq)
 {
-  // Determine effective step (use display step during SCAN_SPARSE)
-  uint16_t effectiveStep = (scanStatus == SCAN_SPARSE && sparseDisplayStep > 0) ? sparseDisplayStep : scanStep;
-
-  // Input frequency must be in range of existing data (allow during SCAN_RADIO/SCAN_SPARSE for progressive display)
-  if((scanStatus!=SCAN_DONE && scanStatus!=SCAN_RADIO && scanStatus!=SCAN_SPARSE) ||
-     (freq<scanStartFreq) || (freq>=scanStartFreq+effectiveStep*scanCount))
-    return(0.0);
+  int idx = scanGetIndex(freq);
+  if(idx < 0) return(0.0);
 
-  uint8_t result = scanData[(freq - scanStartFreq) / effectiveStep].snr;
+  uint8_t result = scanData[idx].snr;
   // Avoid division by zero if range is 0
   if(scanMaxSNR <= scanMinSNR) return 0.5;
   return((result - scanMinSNR) / (float)(scanMaxSNR - scanMinSNR + 1));
 }
 
+//
+// Get raw RSSI/SNR values at given frequency, returns false if no data
+//
+bool scanGetPointAt(uint16_t freq, uint8_t *rssi, uint8_t *snr)
+{
+  int idx = scanGetIndex(freq);
+  if(idx < 0) return(false);
+
+  *rssi = scanData[idx].rssi;
+  *snr  = scanData[idx].snr;
+  return(true);
+}
+
+//
+// Get range of RSSI/SNR values in the current scan data
+//
+void scanGetRange(uint8_t *minRSSI, uint8_t *maxRSSI, uint8_t *minSNR, uint8_t *maxSNR)
+{
+  *minRSSI = scanMinRSSI;
+  *maxRSSI = scanMaxRSSI;
+  *minSNR  = scanMinSNR;
+  *maxSNR  = scanMaxSNR;
+}
+
+//
+// Get frequency range [startFreq, endFreq) covered by the scan data,
+// returns spacing between scan points, or 0 if there is no data
+//
+uint16_t scanGetExtent(uint16_t *startFreq, uint16_t *endFreq)
+{
+  uint16_t effectiveStep = (scanStatus == SCAN_SPARSE && sparseDisplayStep > 0) ? sparseDisplayStep : scanStep;
+
+  if((scanStatus!=SCAN_DONE && scanStatus!=SCAN_RADIO && scanStatus!=SCAN_SPARSE) || !scanCount || !effectiveStep)
+    return(0);
+
+  *startFreq = scanStartFreq;
+  *endFreq   = scanStartFreq + effectiveStep * scanCount;
+  return(effectiveStep);
+}
+
+//
+// Get raw RSSI/SNR ranges over the scan points in [freq1, freq2),
+// returns false if there are no points in given range
+//
+bool scanGetSpan(uint16_t freq1, uint16_t freq2, uint8_t *minRSSI, uint8_t *maxRSSI, uint8_t *minSNR, uint8_t *maxSNR)
+{
+  uint16_t start, end;
+  uint16_t step = scanGetExtent(&start, &end);
+
+  if(!step) return(false);
+  if(freq1 < start) freq1 = start;
+  if(freq2 > end) freq2 = end;
+  if(freq1 >= freq2) return(false);
+
+  // First and last (exclusive) indices of points inside the range
+  int first = (freq1 - start + step - 1) / step;
+  int last  = (freq2 - start + step - 1) / step;
+  if(first >= last) return(false);
+
+  *minRSSI = *maxRSSI = scanData[first].rssi;
+  *minSNR  = *maxSNR  = scanData[first].snr;
+
+  for(int j=first+1 ; j<last ; j++)
+  {
+    *minRSSI = min(*minRSSI, scanData[j].rssi);
+    *maxRSSI = max(*maxRSSI, scanData[j].rssi);
+    *minSNR  = min(*minSNR, scanData[j].snr);
+    *maxSNR  = max(*maxSNR, scanData[j].snr);
+  }
+
+  return(true);
+}
+
+//
+// Get scan data version, changes every time scan data changes
+//
+uint32_t scanGetVersion()
+{
+  return(scanVersion);
+}
+
+//
+// Get scan data epoch, stays the same while points are only appended
+//
+uint32_t scanGetEpoch()
+{
+  return(scanEpoch);
+}
+
+//
+// Fill a chunk of scan data for remote clients: start frequency, step,
+// total points, offset and count (16-bit little endian), followed by
+// RSSI/SNR byte pairs, returns chunk size or 0 if there is no scan data
+//
+uint16_t scanGetChunk(uint8_t *buf, uint16_t offset, uint16_t count)
+{
+  uint16_t total = scanGetCount();
+
+  if(!scanIsReady() || offset > total) return(0);
+  if(count > total - offset) count = total - offset;
+
+  uint16_t hdr[5] = { scanGetStartFreq(), scanGetStep(), total, offset, count };
+  for(int j=0 ; j<5 ; j++)
+  {
+    buf[j * 2] = hdr[j];
+    buf[j * 2 + 1] = hdr[j] >> 8;
+  }
+
+  for(int j=0 ; j<count ; j++)
+    if(!scanGetDataPoint(offset + j, &buf[10 + j * 2], &buf[11 + j * 2]))
+      buf[10 + j * 2] = buf[11 + j * 2] = 0;
+
+  return(10 + count * 2);
+}
+
 static void scanInit(uint16_t centerFreq, uint16_t step)
 {
   scanStep    = step;
@@ -162,6 +337,7 @@ static void scanInit(uint16_t centerFreq, uint16_t step)
 
   // Clear scan data
   memset(scanData, 0, sizeof(scanData));
+  scanChanged();
 }
 
 static bool scanTickTime()
@@ -172,6 +348,14 @@ static bool scanTickTime()
   // Wait for the right time
   if(millis() - scanTime < SCAN_POLL_TIME) return(true);
 
+  // Tuning away before the mute circuit has settled is audible,
+  // scanRun() also needs the sequencer advanced from here
+  if(!muteIsSettled())
+  {
+    muteTickTime();
+    return(true);
+  }
+
   // This is our current frequency to scan
   uint16_t freq = scanStartFreq + scanStep * scanCount;
 
@@ -211,6 +395,9 @@ static bool scanTickTime()
   else
     rx.setFrequency(freq); // Implies tuning delay
 
+  // Look for stations as points arrive
+  scanChanged(true);
+
   // Save last scan time
   scanTime = millis() - SCAN_POLL_TIME;
 
@@ -232,6 +419,10 @@ static bool sparseTickTime()
   if(millis() - scanTime < SCAN_POLL_TIME)
     return true;
 
+  // Tuning away before the mute circuit has settled is audible
+  if(!muteIsSettled())
+    return true;
+
   // Current frequency to scan
   uint16_t freq = scanStartFreq + scanStep * sparseCurrentIdx;
 
@@ -272,6 +463,7 @@ static bool sparseTickTime()
     if(sparseConsecutive >= SPARSE_MAX_CONSECUTIVE)
     {
       scanStatus = SCAN_ERROR;
+      scanChanged();
       return false;
     }
   }
@@ -310,6 +502,7 @@ static bool sparseTickTime()
     {
       // Too many signals found - squelch is too low
       scanStatus = SCAN_ERROR;
+      scanChanged();
       Serial.printf("SPARSE scan error: buffer overflow at sparseCount=%d\n", sparseCount);
       return false;
     }
@@ -388,6 +581,7 @@ static void expandSparseToDense(bool live)
     }
     sparseDisplayStep = scanStep * subsampleStep;
     memset(scanData, 0, scanCount * sizeof(ScanPoint));
+    scanChanged();
     return;
   }
 
@@ -490,6 +684,8 @@ static void expandSparseToDense(bool live)
     sparseDisplayStep = scanStep * subsampleStep;
   }
   // scanStartFreq remains the same
+
+  scanChanged();
 }
 
 //
@@ -497,6 +693,9 @@ static void expandSparseToDense(bool live)
 //
 void scanRun(uint16_t centerFreq, uint16_t step)
 {
+  // Scanning takes over the tuner from a running seek
+  seekAbort();
+
   // Set tuning delay
   rx.setMaxDelaySetFrequency(currentMode == FM ? TUNE_DELAY_FM : TUNE_DELAY_AM_SSB);
   // Mute the audio
@@ -567,6 +766,9 @@ bool scanGetDataPoint(uint16_t index, uint8_t *rssi, uint8_t *snr)
 //
 void scanStartAsync(uint16_t centerFreq, uint16_t step, uint16_t points)
 {
+  // Scanning takes over the tuner from a running seek
+  seekAbort();
+
   // Limit points to available buffer
   if(points > SCAN_POINTS) points = SCAN_POINTS;
   scanMaxPoints = points;
@@ -601,6 +803,7 @@ void scanStartAsync(uint16_t centerFreq, uint16_t step, uint16_t points)
 
   // Clear scan data
   memset(scanData, 0, sizeof(scanData));
+  scanChanged();
 
   // Mark as async scan running
   scanStatus = SCAN_ASYNC;
@@ -611,6 +814,9 @@ void scanStartAsync(uint16_t centerFreq, uint16_t step, uint16_t points)
 //
 void scanStartAsyncFrom(uint16_t startFreq, uint16_t step, uint16_t points)
 {
+  // Scanning takes over the tuner from a running seek
+  seekAbort();
+
   // Limit points to available buffer
   if(points > SCAN_POINTS) points = SCAN_POINTS;
   scanMaxPoints = points;
@@ -644,6 +850,7 @@ void scanStartAsyncFrom(uint16_t startFreq, uint16_t step, uint16_t points)
 
   // Clear scan data
   memset(scanData, 0, sizeof(scanData));
+  scanChanged();
 
   // Mark as async scan running
   scanStatus = SCAN_ASYNC;
@@ -673,6 +880,7 @@ bool scanTickAsync()
     rx.setMaxDelaySetFrequency(TUNE_DELAY_DEFAULT);
     // Mark as done
     scanStatus = SCAN_DONE;
+    scanChanged();
     return false;
   }
 
@@ -732,6 +940,9 @@ uint16_t scanGetOptimalStep()
 //
 void scanStartRadio()
 {
+  // Scanning takes over the tuner from a running seek
+  seekAbort();
+
   const Band *band = getCurrentBand();
 
   // Calculate optimal step for this band (covers full band within buffer limit)
@@ -823,6 +1034,7 @@ void scanStartRadio()
 
   // Clear scan data
   memset(scanData, 0, sizeof(scanData));
+  scanChanged();
 
   // Mark as radio progressive scan running
   scanStatus = SCAN_RADIO;
@@ -854,6 +1066,7 @@ bool scanTickRadio()
       {
         sparseMode = false;
         scanCount = 0;
+        scanChanged();
         return false;
       }
 
@@ -888,6 +1101,7 @@ bool scanTickRadio()
     rx.setMaxDelaySetFrequency(TUNE_DELAY_DEFAULT);
     // Mark as done
     scanStatus = SCAN_DONE;
+    scanChanged();
     // Save to band cache
     scanSaveToBandCache(bandIdx);
     return false;
@@ -927,6 +1141,7 @@ void scanStopRadio()
     {
       scanStatus = SCAN_OFF;
     }
+    scanChanged();
   }
 }
 
@@ -1135,7 +1350,12 @@ void scanSaveToBandCache(uint8_t bandIndex)
   cache->minSNR = scanMinSNR;
   cache->maxSNR = scanMaxSNR;
   cache->lastUsed = millis();
+  cache->scanned = cache->lastUsed;
   cache->valid = true;
+
+  // Working buffer now matches this band's cache
+  scanLoadedBand = bandIndex;
+  scanPeaksPublish();
 }
 
 //
@@ -1147,6 +1367,14 @@ bool scanLoadFromBandCache(uint8_t bandIndex)
     return false;
 
   BandScanCache *cache = &bandScanCache[bandIndex];
+
+  // Nothing to do if this band's data is already loaded
+  if(scanStatus == SCAN_DONE && scanLoadedBand == bandIndex)
+  {
+    cache->lastUsed = millis();
+    return true;
+  }
+
   scanStartFreq = cache->startFreq;
   scanStep = cache->step;
   scanCount = cache->count;
@@ -1158,6 +1386,10 @@ bool scanLoadFromBandCache(uint8_t bandIndex)
 
   // Copy data from pool to working buffer
   memcpy(scanData, &scanPool[cache->poolOffset], cache->count * sizeof(ScanPoint));
+  scanChanged();
+  scanLoadedBand = bandIndex;
+  scanPeakTime = cache->scanned;
+  scanPeaksPublish();
 
   // Update LRU timestamp
   cache->lastUsed = millis();
@@ -1193,6 +1425,11 @@ void scanInvalidateBandCache(uint8_t bandIndex)
 {
   if(bandIndex < MAX_BANDS)
     bandScanCache[bandIndex].valid = false;
+  if(scanLoadedBand == bandIndex)
+  {
+    scanLoadedBand = -1;
+    scanPeaksPublish();
+  }
 }
 
 //
@@ -1227,6 +1464,13 @@ void scanSetBandCacheData(uint8_t bandIndex, uint16_t startFreq, uint16_t step,
   if(bandIndex >= MAX_BANDS || count == 0 || count > SCAN_POINTS)
     return;
 
+  // Working buffer no longer matches this band's cache
+  if(scanLoadedBand == bandIndex)
+  {
+    scanLoadedBand = -1;
+    scanPeaksPublish();
+  }
+
   // If this band already has data, invalidate it first
   if(bandScanCache[bandIndex].valid)
   {
@@ -1257,5 +1501,204 @@ void scanSetBandCacheData(uint8_t bandIndex, uint16_t startFreq, uint16_t step,
   cache->minSNR = minSNR;
   cache->maxSNR = maxSNR;
   cache->lastUsed = millis();
+  cache->scanned = 0;
   cache->valid = true;
 }
+
+//
+// Station list
+//
+// Stations are found in scanData[] as points arrive, in a single pass:
+// the noise floor is smoothed so that it follows the signal down fast
+// and up slowly, and every run of adjacent points at least
+// SCAN_PEAK_MARGIN above it is merged into one station. Its frequency
+// is the centroid of the run, weighted by the signal above the floor.
+// The centroid is only shown, tuning uses the strongest scanned point,
+// which is always on the scan grid.
+//
+
+//
+// Close the open peak, adding it to the station list
+//
+static void scanPeakClose()
+{
+  uint16_t step = (scanStatus == SCAN_SPARSE && sparseDisplayStep > 0) ? sparseDisplayStep : scanStep;
+  uint32_t weight = scanPeakWeight;
+
+  scanPeakWeight = 0;
+
+  // List is full, replace the weakest station if this one is stronger
+  // (stations are found in frequency order, so this one goes last)
+  if(scanPeakCount >= SCAN_PEAKS)
+  {
+    uint8_t weakest = 0;
+    for(uint8_t i = 1; i < scanPeakCount; i++)
+      if(scanPeaks[i].rssi < scanPeaks[weakest].rssi) weakest = i;
+
+    if(scanPeaks[weakest].rssi >= scanPeakRSSI) return;
+
+    memmove(&scanPeaks[weakest], &scanPeaks[weakest + 1], (scanPeakCount - weakest - 1) * sizeof(ScanPeak));
+    scanPeakCount--;
+  }
+
+  ScanPeak *peak = &scanPeaks[scanPeakCount++];
+  peak->freq = scanStartFreq + scanPeakStart * step + (scanPeakMoment * step + weight / 2) / weight;
+  peak->tune = scanStartFreq + scanPeakBest * step;
+  peak->rssi = scanPeakRSSI;
+  peak->snr  = scanPeakSNR;
+}
+
+//
+// Examine scanData[] points that have arrived since the last call
+//
+static void scanPeaksUpdate()
+{
+  for(; scanPeakNext < scanCount; scanPeakNext++)
+  {
+    const ScanPoint *point = &scanData[scanPeakNext];
+    uint16_t level = point->rssi << 4;
+
+    // Follow the noise floor down fast and up slowly
+    if(!scanPeakNext)
+      scanPeakFloor = level;
+    else if(level < scanPeakFloor)
+      scanPeakFloor = (scanPeakFloor + level) / 2;
+    else
+      scanPeakFloor += (level - scanPeakFloor) >> SCAN_FLOOR_RISE;
+
+    uint8_t noise = scanPeakFloor >> 4;
+
+    if(point->rssi < noise + SCAN_PEAK_MARGIN)
+    {
+      if(scanPeakWeight) scanPeakClose();
+      continue;
+    }
+
+    // Open a new peak or add this point to the open one
+    if(!scanPeakWeight)
+    {
+      scanPeakStart  = scanPeakNext;
+      scanPeakMoment = 0;
+      scanPeakRSSI   = 0;
+      scanPeakSNR    = 0;
+    }
+
+    // Tune to the strongest point, the centroid may be off the grid
+    if(point->rssi > scanPeakRSSI) scanPeakBest = scanPeakNext;
+
+    uint8_t weight = point->rssi - noise;
+    scanPeakWeight += weight;
+    scanPeakMoment += (uint32_t)(scanPeakNext - scanPeakStart) * weight;
+    scanPeakRSSI    = max(scanPeakRSSI, point->rssi);
+    scanPeakSNR     = max(scanPeakSNR, point->snr);
+  }
+
+  // Peak running into the end of a complete scan
+  if(scanStatus == SCAN_DONE && scanPeakWeight) scanPeakClose();
+}
+
+//
+// Get band the station list belongs to, -1 if none
+//
+static int8_t scanPeaksBand()
+{
+  if(scanLoadedBand >= 0) return(scanLoadedBand);
+
+  // Fresh scan data (not from the cache) belongs to the current band
+  const Band *band = getCurrentBand();
+  if(scanStatus != SCAN_OFF && scanStartFreq >= band->minimumFreq && scanStartFreq <= band->maximumFreq)
+    return(bandIdx);
+
+  return(-1);
+}
+
+//
+// Copy the station list for scanCopyPeaks(), called whenever it or
+// the band it belongs to may have changed
+//
+static void scanPeaksPublish()
+{
+  int8_t band = scanPeaksBand();
+
+  portENTER_CRITICAL(&scanPeakLock);
+  scanPeakShared.band  = band;
+  scanPeakShared.count = scanPeakCount;
+  scanPeakShared.time  = scanPeakTime;
+  memcpy(scanPeakShared.peaks, scanPeaks, scanPeakCount * sizeof(ScanPeak));
+  portEXIT_CRITICAL(&scanPeakLock);
+}
+
+//
+// Get stations found by the scan of given band, returns the number of
+// stations, 0 if scanData[] holds no data for this band (load it with
+// scanLoadFromBandCache() first). The time the band was scanned at
+// (millis(), 0 if unknown) is returned in time. Main loop only, other
+// tasks must use scanCopyPeaks().
+//
+uint8_t scanGetPeaks(uint8_t bandIndex, const ScanPeak **peaks, uint32_t *time)
+{
+  if(time) *time = 0;
+  if(bandIndex >= getTotalBands() || scanPeaksBand() != bandIndex) return(0);
+
+  if(peaks) *peaks = scanPeaks;
+  if(time)  *time  = scanPeakTime;
+  return(scanPeakCount);
+}
+
+//
+// Copy up to max stations found by the scan of given band, same as
+// scanGetPeaks(). Safe to call from any task, but not from an ISR.
+//
+uint8_t scanCopyPeaks(uint8_t bandIndex, ScanPeak *peaks, uint8_t max, uint32_t *time)
+{
+  uint8_t count = 0;
+
+  portENTER_CRITICAL(&scanPeakLock);
+  if(scanPeakShared.band == bandIndex)
+  {
+    count = scanPeakShared.count < max? scanPeakShared.count : max;
+    memcpy(peaks, scanPeakShared.peaks, count * sizeof(ScanPeak));
+  }
+  if(time) *time = count? scanPeakShared.time : 0;
+  portEXIT_CRITICAL(&scanPeakLock);
+
+  return(count);
+}
+
+//
+// Find the next station above or below given frequency, out of those
+// scanGetPeaks() lists for a recent scan of given band. Loads the band
+// cache if needed, but never while scanning. Returns 0 if there is no
+// recent scan or no station in that direction. The RSSI a live station
+// is expected to have is returned in threshold.
+//
+uint16_t scanFindStation(uint8_t bandIndex, uint16_t freq, int8_t dir, uint8_t *threshold)
+{
+  const ScanPeak *peaks;
+  uint32_t time;
+
+  if(scanIsRunning() || scanIsRadioRunning()) return(0);
+
+  uint8_t count = scanGetPeaks(bandIndex, &peaks, &time);
+  if(!count && scanLoadFromBandCache(bandIndex))
+    count = scanGetPeaks(bandIndex, &peaks, &time);
+
+  if(!count || !time || (millis() - time) > SCAN_SEEK_AGE) return(0);
+
+  // Stations are listed in frequency order, tune frequencies are on
+  // the scan grid unlike their centroids
+  const ScanPeak *found = 0;
+  for(uint8_t i = 0; i < count; i++)
+  {
+    if(dir > 0 && peaks[i].tune > freq) { found = &peaks[i]; break; }
+    if(dir < 0 && peaks[i].tune < freq) found = &peaks[i];
+  }
+
+  if(!found) return(0);
+
+  // Allow the station to have faded a bit since the scan
+  if(threshold)
+    *threshold = found->rssi > SCAN_PEAK_MARGIN? found->rssi - SCAN_PEAK_MARGIN : 0;
+
+  return(found->tune);
+}
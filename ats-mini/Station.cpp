@@ -8,6 +8,9 @@
 #define MIN_CB_FREQUENCY 26060
 #define MAX_CB_FREQUENCY 27995
 
+// Station name must stay the same this long to be remembered (ms)
+#define STATION_PS_STABLE 10000
+
 //
 // Named frequencies, sorted by increasing frequency!
 //
@@ -68,6 +71,12 @@ static char bufStationName[50]  = "";
 static char bufRadioText[100]   = "";
 static char bufProgramInfo[100] = "";
 static uint16_t piCode = 0x0000;
+static uint16_t cachedPi = 0x0000;  // PI code last looked up in the database
+static bool nameCached = false;     // TRUE: station name is from the database
+static char psSeen[9] = "";         // Station name last received
+static uint16_t psPi = 0x0000;      // PI code psSeen was received with
+static uint32_t psTime = 0;         // Time psSeen was first received
+static bool psStored = false;       // TRUE: station name stored since tuning
 
 const char *getStationName()
 {
@@ -99,6 +108,11 @@ void clearStationInfo()
   bufRadioText[0]   = '\0'; // Multiline!
   bufRadioText[1]   = '\0';
   piCode = 0x0000;
+  cachedPi = 0x0000;
+  nameCached = false;
+  psSeen[0] = '\0';
+  psStored = false;
+  rdsReset();
 }
 
 static bool showStationName(const char *stationName, bool isLong = false)
@@ -198,47 +212,82 @@ static bool showRdsPiCode(uint16_t rdsPiCode)
   return(false);
 }
 
-static bool showRdsTime(const char *rdsTime)
+static bool showRdsTime(uint8_t hours, uint8_t minutes)
 {
   // If NTP time available, do not use RDS time
-  if(!rdsTime || ntpIsAvailable()) return(false);
-
-  // The standard RDS time format is �HH:MM�.
-  // or sometimes more complex like �DD.MM.YY,HH:MM�.
-  const char *timeField = strstr(rdsTime, ":");
+  return(!ntpIsAvailable() && clockSet(hours, minutes));
+}
 
-  // If we find a valid time format...
-  if(timeField && (timeField>=rdsTime+2) && timeField[1] && timeField[2])
-  {
-    // Extract hours and minutes
-    int hours = (timeField[-2] - '0') * 10 + timeField[-1] - '0';
-    int mins  = (timeField[1] - '0') * 10 + timeField[2] - '0';
+//
+// Show station name and program type remembered for this frequency
+// and PI code (any PI code if 0)
+//
+static bool showCachedStation(uint16_t freq, uint16_t pi)
+{
+  uint8_t mode = getRDSMode();
+  const char *ps;
+  int pty;
 
-    // If hours and minutes are valid, update clock
-    if(hours>=0 && hours<24 && mins>=0 && mins<60)
-      return(clockSet(hours, mins));
-  }
+  if(!(mode & RDS_PS) || !stationDbLookup(freq, pi, &ps, &pty)) return(false);
 
-  // No time
-  return(false);
+  bool changed = showStationName(ps);
+  if((mode & RDS_PT) && pty>=0) changed |= showRdsProgramType(pty, !!(mode & RDS_RBDS));
+  nameCached = true;
+  return(changed);
 }
 
 bool checkRds()
 {
   bool needRedraw = false;
   uint8_t mode = getRDSMode();
+  uint8_t hours, minutes;
+
+  // Decode all received groups, even if nothing has changed on screen
+  bool changed = rdsPoll();
 
-  rx.getRdsStatus();
+  uint16_t pi = rdsGetPI();
+  const char *ps = rdsGetPS();
 
-  if(rx.getRdsReceived() && rx.getRdsSync() && rx.getRdsSyncFound())
+  // Remember the first station name that stays the same for a while,
+  // so that dynamic (scrolling) names are not stored. A steady name
+  // changes nothing, so this is checked whatever rdsPoll() returns.
+  if(pi && ps)
   {
-    needRedraw |= (mode & RDS_PS) && showStationName(rx.getRdsStationName());
-    needRedraw |= (mode & RDS_RT) && showRadioText(rx.getRdsVersionCode()? rx.getRdsText2B() : rx.getRdsText2A());
-    needRedraw |= (mode & RDS_PI) && showRdsPiCode(rx.getRdsPI());
-    needRedraw |= (mode & RDS_CT) && showRdsTime(rx.getRdsTime());
-    needRedraw |= (mode & RDS_PT) && showRdsProgramType(rx.getRdsProgramTypeX(), !!(mode & RDS_RBDS));
+    if(pi!=psPi || strcmp(psSeen, ps))
+    {
+      strlcpy(psSeen, ps, sizeof(psSeen));
+      psPi = pi;
+      psTime = millis();
+    }
+    else if(!psStored && (millis() - psTime) >= STATION_PS_STABLE)
+    {
+      stationDbStore(currentFrequency, pi, ps, rdsGetPTY());
+      psStored = true;
+    }
   }
 
+  if(!changed) return(false);
+
+  if(pi && !ps && pi!=cachedPi && (nameCached || !bufStationName[0]))
+  {
+    // PI code is known long before the name, confirm or replace the
+    // name shown on tune, or drop it if it belongs to another station
+    cachedPi = pi;
+    if(showCachedStation(currentFrequency, pi))
+      needRedraw = true;
+    else if(nameCached)
+    {
+      nameCached = false;
+      needRedraw |= showStationName("");
+    }
+  }
+
+  needRedraw |= (mode & RDS_PS) && showStationName(rdsGetPS());
+  needRedraw |= (mode & RDS_RT) && showRadioText(rdsGetRT());
+  needRedraw |= (mode & RDS_PI) && showRdsPiCode(rdsGetPI());
+  needRedraw |= (mode & RDS_CT) && rdsGetTime(&hours, &minutes) && showRdsTime(hours, minutes);
+  needRedraw |= (mode & RDS_PT) && (rdsGetPTY()>=0) && showRdsProgramType(rdsGetPTY(), !!(mode & RDS_RBDS));
+
   // Return TRUE if any RDS information changes
   return(needRedraw);
 }
@@ -424,7 +473,8 @@ bool identifyFrequency(uint16_t freq, bool periodic)
         break;
 
       case 1: // RDS - let the RDS system handle it (for FM mode)
-        if(currentMode == FM) return(false);
+        // Until then, show the last name received on this frequency
+        if(currentMode == FM) return(!periodic && showCachedStation(freq, 0));
         break;
 
       case 2: // EIBI
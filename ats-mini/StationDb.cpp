@@ -0,0 +1,205 @@
+#include "Common.h"
+#include <LittleFS.h>
+#include <FS.h>
+
+//
+// FM station database
+//
+// Station names (RDS PS) and program types are remembered for every
+// (frequency, PI code) pair they have been received with, so that the
+// name can be shown as soon as the station is tuned, instead of waiting
+// for the whole PS to arrive again. When the PI code is received (that
+// takes a fraction of a second), the name is either confirmed or
+// replaced with the one stored for this PI.
+//
+// All records are kept in RAM, with a hash index by frequency, and the
+// file is rewritten after a period without changes.
+//
+
+#define STATIONDB_PATH    "/stations.bin"
+#define STATIONDB_TEMP    "/stations.tmp"
+#define STATIONDB_MAGIC   0x31424453  // "SDB1"
+#define STATIONDB_SIZE    256         // Maximum number of stations
+#define STATIONDB_BUCKETS 64          // Hash buckets, power of two
+#define STATIONDB_STORE   10000       // Time of inactivity before saving (ms)
+
+typedef struct __attribute__((packed))
+{
+  uint16_t freq;          // Frequency (10 kHz units)
+  uint16_t pi;            // RDS PI code
+  uint16_t seen;          // Last use (sequence number)
+  uint8_t  pty;           // RDS program type
+  char     ps[9];         // RDS station name
+} StationRecord;
+
+static StationRecord stationDb[STATIONDB_SIZE];
+static uint16_t stationCount = 0;
+static uint16_t stationSeen = 0;
+
+// Hash index: bucket heads and per-record chains (-1 = end)
+static int16_t stationBuckets[STATIONDB_BUCKETS];
+static int16_t stationNext[STATIONDB_SIZE];
+
+static bool stationDirty = false;
+static uint32_t stationTime = 0;
+
+static inline int stationHash(uint16_t freq)
+{
+  return((freq * 40503U >> 8) & (STATIONDB_BUCKETS - 1));
+}
+
+static void stationIndex()
+{
+  memset(stationBuckets, 0xFF, sizeof(stationBuckets));
+
+  for(int j=0 ; j<stationCount ; j++)
+  {
+    int h = stationHash(stationDb[j].freq);
+    stationNext[j] = stationBuckets[h];
+    stationBuckets[h] = j;
+  }
+}
+
+//
+// Load station database from the file system
+//
+void stationDbInit()
+{
+  uint32_t magic = 0;
+
+  stationCount = 0;
+  stationSeen  = 0;
+
+  fs::File file = LittleFS.open(STATIONDB_PATH, "rb");
+  if(file)
+  {
+    if(file.read((uint8_t *)&magic, sizeof(magic))==sizeof(magic) && magic==STATIONDB_MAGIC)
+    {
+      while(stationCount<STATIONDB_SIZE &&
+        file.read((uint8_t *)&stationDb[stationCount], sizeof(StationRecord))==sizeof(StationRecord))
+      {
+        StationRecord *r = &stationDb[stationCount++];
+        r->ps[8] = '\0';
+        if((int16_t)(r->seen - stationSeen) > 0) stationSeen = r->seen;
+      }
+    }
+
+    file.close();
+  }
+
+  stationIndex();
+}
+
+//
+// Write station database to the file system
+//
+static bool stationDbSave()
+{
+  uint32_t magic = STATIONDB_MAGIC;
+
+  fs::File file = LittleFS.open(STATIONDB_TEMP, "wb");
+  if(!file) return(false);
+
+  bool ok =
+    file.write((const uint8_t *)&magic, sizeof(magic))==sizeof(magic) &&
+    file.write((const uint8_t *)stationDb, stationCount * sizeof(StationRecord))==stationCount * sizeof(StationRecord);
+
+  file.close();
+
+  if(!ok)
+  {
+    LittleFS.remove(STATIONDB_TEMP);
+    return(false);
+  }
+
+  LittleFS.remove(STATIONDB_PATH);
+  return(LittleFS.rename(STATIONDB_TEMP, STATIONDB_PATH));
+}
+
+//
+// Save changes when there has been no activity for a while
+//
+void stationDbTickTime()
+{
+  if(stationDirty && (millis() - stationTime) >= STATIONDB_STORE)
+  {
+    stationDirty = false;
+    stationDbSave();
+  }
+}
+
+//
+// Find station by frequency and PI code, any PI code if pi is 0
+// Returns the most recently used match
+//
+static StationRecord *stationFind(uint16_t freq, uint16_t pi)
+{
+  StationRecord *result = 0;
+
+  for(int j=stationBuckets[stationHash(freq)] ; j>=0 ; j=stationNext[j])
+  {
+    StationRecord *r = &stationDb[j];
+    if(r->freq==freq && (!pi || r->pi==pi))
+      if(!result || (int16_t)(r->seen - result->seen) > 0) result = r;
+  }
+
+  return(result);
+}
+
+//
+// Look up station name and program type (or -1), returns false if
+// not found. With pi=0, returns the last station heard at freq.
+//
+bool stationDbLookup(uint16_t freq, uint16_t pi, const char **ps, int *pty)
+{
+  const StationRecord *r = stationFind(freq, pi);
+  if(!r) return(false);
+
+  if(ps)  *ps  = r->ps;
+  if(pty) *pty = r->pty<32? r->pty : -1;
+  return(true);
+}
+
+//
+// Remember station name and program type (-1 if unknown)
+//
+void stationDbStore(uint16_t freq, uint16_t pi, const char *ps, int pty)
+{
+  if(!pi || !ps) return;
+
+  StationRecord *r = stationFind(freq, pi);
+
+  // Nothing new, just mark the station as recently used
+  if(r && !strncmp(r->ps, ps, 8) && (pty<0 || r->pty==pty))
+  {
+    r->seen = ++stationSeen;
+    return;
+  }
+
+  if(!r)
+  {
+    if(stationCount < STATIONDB_SIZE)
+      r = &stationDb[stationCount++];
+    else
+    {
+      // Replace least recently used station
+      r = &stationDb[0];
+      for(int j=1 ; j<stationCount ; j++)
+        if((int16_t)(stationDb[j].seen - r->seen) < 0) r = &stationDb[j];
+    }
+
+    memset(r, 0, sizeof(*r));
+    r->freq = freq;
+    r->pi   = pi;
+    r->pty  = 0xFF;
+    stationIndex();
+  }
+
+  strncpy(r->ps, ps, 8);
+  r->ps[8] = '\0';
+  if(pty >= 0) r->pty = pty;
+  r->seen = ++stationSeen;
+
+  stationDirty = true;
+  stationTime  = millis();
+}
@@ -0,0 +1,242 @@
+#include "Common.h"
+#include "Menu.h"
+
+//
+// Telemetry stream
+//
+// Serial, BLE and WebSocket clients can each subscribe to a stream of
+// text lines carrying the selected fields at a fixed rate, up to 50 Hz:
+//
+//   T,<sequence>,<time (ms)>[,<field>...]
+//
+// Fields are selected with letters and always sent in this order:
+// F = frequency, B = BFO, R = RSSI, S = SNR, C = antenna capacitor,
+// V = battery voltage (mV), M = mode.
+//
+// All streams, as well as the rest of the firmware, take RSSI/SNR
+// from the shared sampler below, so the chip is queried only once per
+// period no matter how many clients are listening.
+//
+
+#define TELEMETRY_MIN_PERIOD  20    // Fastest rate, 50 Hz (ms)
+#define TELEMETRY_MAX_PERIOD  60000 // Slowest rate (ms)
+#define TELEMETRY_BATT_PERIOD 1000  // Battery voltage update period (ms)
+#define TELEMETRY_CAP_PERIOD  1000  // Capacitor refresh period for telemetryCached() (ms)
+#define TELEMETRY_CACHED_IDLE 10000 // Stop refreshing for telemetryCached() after (ms)
+#define TELEMETRY_LINE        96    // Maximum line length
+
+// Field bits, in output order
+#define FIELD_FREQ      0x01
+#define FIELD_BFO       0x02
+#define FIELD_RSSI      0x04
+#define FIELD_SNR       0x08
+#define FIELD_CAP       0x10
+#define FIELD_VOLTAGE   0x20
+#define FIELD_MODE      0x40
+
+static const char telemetryFields[] = "FBRSCVM";
+
+typedef struct
+{
+  uint16_t period;   // Period (ms), 0 = off
+  uint8_t  fields;   // FIELD_* bits
+  uint8_t  seq;      // Sequence number
+  uint32_t time;     // Last sent time
+} TelemetrySink;
+
+static TelemetrySink telemetrySinks[TELEMETRY_SINKS];
+
+// Shared sampler state
+static uint32_t sampleTime = 0;
+static uint8_t  sampleRssi = 0;
+static uint8_t  sampleSnr  = 0;
+static uint32_t capTime = 0;
+static uint16_t capValue = 0;
+static uint32_t battTime = 0;
+static uint16_t battValue = 0;
+static volatile uint32_t cachedTime = 0; // Last telemetryCached() call
+
+//
+// Get RSSI and SNR, querying the chip only if the last sample is older
+// than maxAge (ms). Called from the main loop only.
+//
+void telemetrySignal(uint8_t *rssi, uint8_t *snr, uint32_t maxAge)
+{
+  uint32_t now = millis();
+
+  if(!sampleTime || (now - sampleTime) >= maxAge)
+  {
+    rx.getCurrentReceivedSignalQuality();
+    sampleRssi = rx.getCurrentRSSI();
+    sampleSnr  = rx.getCurrentSNR();
+    sampleTime = now? now : 1;
+  }
+
+  *rssi = sampleRssi;
+  *snr  = sampleSnr;
+}
+
+//
+// Get antenna tuning capacitor, same as telemetrySignal()
+//
+uint16_t telemetryCapacitor(uint32_t maxAge)
+{
+  uint32_t now = millis();
+
+  // Reading the capacitor would cancel a running hardware seek, and
+  // scans are busy tuning the chip
+  if(seekIsRunning() || scanIsRunning() || scanIsRadioRunning()) return(capValue);
+
+  if(!capTime || (now - capTime) >= maxAge)
+  {
+    // Use rx.getFrequency to force read of capacitor value from SI4732/5
+    rx.getFrequency();
+    capValue = rx.getAntennaTuningCapacitor();
+    capTime = now? now : 1;
+  }
+
+  return(capValue);
+}
+
+//
+// Get battery voltage (mV), measured at most once a second
+//
+uint16_t telemetryVoltage()
+{
+  uint32_t now = millis();
+
+  if(!battTime || (now - battTime) >= TELEMETRY_BATT_PERIOD)
+  {
+    battValue = batteryMonitor() * 1000;
+    battTime = now? now : 1;
+  }
+
+  return(battValue);
+}
+
+//
+// Get the last values sampled by the main loop, without touching the
+// chip or the ADC. Safe to call from other tasks (web server). The main
+// loop only keeps the capacitor and voltage fresh while this is being
+// called, so the very first call may return stale values.
+//
+void telemetryCached(uint8_t *rssi, uint8_t *snr, uint16_t *cap, uint16_t *voltage)
+{
+  uint32_t now = millis();
+  cachedTime = now? now : 1;
+
+  if(rssi)    *rssi    = sampleRssi;
+  if(snr)     *snr     = sampleSnr;
+  if(cap)     *cap     = capValue;
+  if(voltage) *voltage = battValue;
+}
+
+//
+// Subscribe sink to the telemetry stream, period 0 stops it
+//
+void telemetrySubscribe(uint8_t sink, uint16_t period, uint8_t fields)
+{
+  if(sink >= TELEMETRY_SINKS) return;
+
+  TelemetrySink *s = &telemetrySinks[sink];
+  s->period = period? constrain(period, TELEMETRY_MIN_PERIOD, TELEMETRY_MAX_PERIOD) : 0;
+  s->fields = fields;
+  s->seq    = 0;
+  s->time   = millis() - s->period;
+}
+
+//
+// Parse subscription: <period>[,<fields>], returns false if invalid
+// Fields default to frequency, RSSI and SNR
+//
+bool telemetryConfigure(uint8_t sink, const char *args)
+{
+  uint32_t period = 0;
+  uint8_t fields = 0;
+
+  while(*args >= '0' && *args <= '9' && period <= TELEMETRY_MAX_PERIOD)
+    period = period * 10 + (*args++ - '0');
+
+  if(*args == ',')
+  {
+    for(args++ ; *args > ' ' ; args++)
+    {
+      const char *f = strchr(telemetryFields, toupper(*args));
+      if(!f) return(false);
+      fields |= 1 << (f - telemetryFields);
+    }
+  }
+  else
+    fields = FIELD_FREQ | FIELD_RSSI | FIELD_SNR;
+
+  if(*args || period > TELEMETRY_MAX_PERIOD) return(false);
+
+  telemetrySubscribe(sink, period, fields);
+  return(true);
+}
+
+//
+// Format a telemetry line, returns its length
+//
+static int telemetryFormat(char *buf, TelemetrySink *s, uint32_t now, uint8_t rssi, uint8_t snr)
+{
+  int n = sprintf(buf, "T,%u,%lu", s->seq++, (unsigned long)now);
+
+  if(s->fields & FIELD_FREQ)    n += sprintf(buf + n, ",%u", currentFrequency);
+  if(s->fields & FIELD_BFO)     n += sprintf(buf + n, ",%d", currentBFO);
+  if(s->fields & FIELD_RSSI)    n += sprintf(buf + n, ",%u", rssi);
+  if(s->fields & FIELD_SNR)     n += sprintf(buf + n, ",%u", snr);
+  if(s->fields & FIELD_CAP)     n += sprintf(buf + n, ",%u", telemetryCapacitor(TELEMETRY_MIN_PERIOD / 2));
+  if(s->fields & FIELD_VOLTAGE) n += sprintf(buf + n, ",%u", telemetryVoltage());
+  if(s->fields & FIELD_MODE)    n += sprintf(buf + n, ",%s", bandModeDesc[currentMode]);
+
+  buf[n++] = '\r';
+  buf[n++] = '\n';
+  return(n);
+}
+
+//
+// Send telemetry lines to the subscribed sinks
+//
+void telemetryTickTime()
+{
+  uint32_t now = millis();
+  char buf[TELEMETRY_LINE];
+
+  // Keep cached values fresh while telemetryCached() is being called
+  uint32_t cached = cachedTime;
+  if(cached && (int32_t)(now - cached) < TELEMETRY_CACHED_IDLE)
+  {
+    telemetryCapacitor(TELEMETRY_CAP_PERIOD);
+    telemetryVoltage();
+  }
+
+  for(int j=0 ; j<TELEMETRY_SINKS ; j++)
+  {
+    TelemetrySink *s = &telemetrySinks[j];
+
+    if(!s->period || (now - s->time) < s->period) continue;
+
+    // Keep the rate, but do not try to catch up after a stall
+    s->time = (now - s->time) < 2 * s->period? s->time + s->period : now;
+
+    // Sinks that are due at about the same time share one sample
+    uint8_t rssi, snr;
+    telemetrySignal(&rssi, &snr, TELEMETRY_MIN_PERIOD / 2);
+    int n = telemetryFormat(buf, s, now, rssi, snr);
+
+    switch(j)
+    {
+      case TELEMETRY_SERIAL:
+        // Drop the line rather than wait for the host
+        if(Serial.availableForWrite() >= n) Serial.write(buf, n);
+        break;
+      case TELEMETRY_BLE:
+        bleWrite((const uint8_t *)buf, n);
+        break;
+      case TELEMETRY_WS:
+        netTelemetrySend(buf, n);
+        break;
+    }
+  }
+}
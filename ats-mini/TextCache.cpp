@@ -0,0 +1,225 @@
+#include "Common.h"
+#include "Draw.h"
+#include <esp_heap_caps.h>
+
+//
+// Text render cache
+//
+// The same strings get drawn on every screen refresh, each time
+// rasterizing their glyphs from the RLE encoded built-in fonts. This
+// cache keeps recently drawn strings as ready to blit pixel blocks in
+// PSRAM, keyed by (string, font, color). Cached text is copied into the
+// sprite, skipping the background pixels, so it looks exactly as if it
+// was drawn with a transparent background.
+//
+// Text that changes all the time, such as the frequency while tuning,
+// would miss on every refresh. textCacheDrawGlyphs() caches it one
+// character at a time instead, so only a handful of digits is ever
+// rasterized.
+//
+// Only numbered fonts are cached, free fonts are drawn directly. When
+// PSRAM is not available, everything is drawn directly as well.
+//
+
+#define TEXT_CACHE_SIZE  48            // Number of cached strings (and glyphs)
+#define TEXT_CACHE_LEN   64            // Maximum cached string length
+#define TEXT_CACHE_BYTES (256 * 1024)  // Maximum total pixel memory
+#define TEXT_MAX_WIDTH   320           // Maximum cached text width
+#define TEXT_MAX_HEIGHT  48            // Maximum cached text height (font 7)
+
+typedef struct
+{
+  uint32_t hash;                       // String hash (0 = unused entry)
+  uint32_t used;                       // Last use time, for LRU eviction
+  uint16_t color;                      // Text color
+  uint16_t bg;                         // Background color (transparent)
+  uint8_t  font;                       // Font number
+  int16_t  w, h;                       // Text size (pixels)
+  uint16_t *pixels;                    // Rasterized text (sprite format)
+  char     text[TEXT_CACHE_LEN];       // Cached string
+} TextEntry;
+
+static TextEntry textCache[TEXT_CACHE_SIZE];
+static uint32_t textCacheClock = 0;
+static uint32_t textCacheBytes = 0;
+
+// Scratch sprite used for rasterizing strings
+static TFT_eSprite textSpr = TFT_eSprite(&tft);
+static bool textSprReady = false;
+
+static uint32_t textHash(const char *text, uint8_t font, uint16_t color)
+{
+  uint32_t h = 2166136261UL ^ font ^ (color << 8);
+  while(*text) h = (h ^ (uint8_t)*text++) * 16777619UL;
+  return(h? h : 1);
+}
+
+static void textCacheFree(TextEntry *e)
+{
+  if(e->pixels)
+  {
+    heap_caps_free(e->pixels);
+    textCacheBytes -= e->w * e->h * 2;
+  }
+  e->pixels = 0;
+  e->hash = 0;
+}
+
+//
+// Find cached string, rasterizing it if needed, returns 0 on failure
+//
+static TextEntry *textCacheGet(const char *text, uint8_t font, uint16_t color)
+{
+  // Only numbered fonts and short strings, and only with PSRAM
+  if(font==1 || strlen(text)>=TEXT_CACHE_LEN || !psramFound()) return(0);
+
+  uint32_t hash = textHash(text, font, color);
+  TextEntry *lru = &textCache[0];
+
+  for(int j=0 ; j<TEXT_CACHE_SIZE ; j++)
+  {
+    TextEntry *e = &textCache[j];
+    if(e->hash==hash && e->font==font && e->color==color && e->bg==TH.bg && !strcmp(e->text, text))
+    {
+      e->used = ++textCacheClock;
+      return(e);
+    }
+    if(e->used < lru->used) lru = e;
+  }
+
+  // Lazily create the scratch sprite
+  if(!textSprReady)
+  {
+    textSpr.setColorDepth(16);
+    textSprReady = !!textSpr.createSprite(TEXT_MAX_WIDTH, TEXT_MAX_HEIGHT);
+    if(!textSprReady) return(0);
+  }
+
+  int16_t w = textSpr.textWidth(text, font);
+  int16_t h = textSpr.fontHeight(font);
+  if(w<=0 || w>TEXT_MAX_WIDTH || h<=0 || h>TEXT_MAX_HEIGHT) return(0);
+
+  // Evict least recently used strings until the new one fits
+  textCacheFree(lru);
+  while(textCacheBytes + w * h * 2 > TEXT_CACHE_BYTES)
+  {
+    TextEntry *e = 0;
+    for(int j=0 ; j<TEXT_CACHE_SIZE ; j++)
+      if(textCache[j].pixels && (!e || textCache[j].used < e->used)) e = &textCache[j];
+    if(!e) return(0);
+    textCacheFree(e);
+  }
+
+  lru->pixels = (uint16_t *)heap_caps_malloc(w * h * 2, MALLOC_CAP_SPIRAM);
+  if(!lru->pixels) return(0);
+
+  // Rasterize string into the scratch sprite and copy it out
+  textSpr.fillRect(0, 0, w, h, TH.bg);
+  textSpr.setTextDatum(TL_DATUM);
+  textSpr.setTextColor(color);
+  textSpr.drawString(text, 0, 0, font);
+
+  const uint16_t *src = (const uint16_t *)textSpr.getPointer();
+  for(int y=0 ; y<h ; y++)
+    memcpy(lru->pixels + y * w, src + y * TEXT_MAX_WIDTH, w * 2);
+
+  textCacheBytes += w * h * 2;
+  lru->hash  = hash;
+  lru->used  = ++textCacheClock;
+  lru->color = color;
+  lru->bg    = TH.bg;
+  lru->font  = font;
+  lru->w     = w;
+  lru->h     = h;
+  strcpy(lru->text, text);
+  return(lru);
+}
+
+//
+// Get text width, same as spr.textWidth()
+//
+int textCacheWidth(const char *text, uint8_t font, uint16_t color)
+{
+  TextEntry *e = textCacheGet(text, font, color);
+  return(e? e->w : spr.textWidth(text, font));
+}
+
+//
+// Draw text with transparent background, same as spr.drawString(),
+// supports top and middle datums only, returns text width
+//
+int textCacheDraw(const char *text, int x, int y, uint8_t font, uint8_t datum, uint16_t color)
+{
+  uint16_t *img = (uint16_t *)spr.getPointer();
+  TextEntry *e = datum<=MR_DATUM && img? textCacheGet(text, font, color) : 0;
+
+  if(!e)
+  {
+    spr.setTextDatum(datum);
+    spr.setTextColor(color);
+    return(spr.drawString(text, x, y, font));
+  }
+
+  // Apply datum
+  switch(datum % 3)
+  {
+    case 1: x -= e->w / 2; break;
+    case 2: x -= e->w; break;
+  }
+  if(datum >= ML_DATUM) y -= e->h / 2;
+
+  // Clip to the sprite
+  int16_t sw = spr.width();
+  int16_t sh = spr.height();
+  int x0 = x < 0? -x : 0;
+  int x1 = x + e->w > sw? sw - x : e->w;
+
+  // Background pixels are transparent (sprites keep swapped colors)
+  uint16_t key = (e->bg >> 8) | (e->bg << 8);
+
+  for(int j=0 ; j<e->h ; j++)
+  {
+    if(y + j < 0 || y + j >= sh) continue;
+
+    const uint16_t *src = e->pixels + j * e->w;
+    uint16_t *dst = img + (y + j) * sw + x;
+
+    for(int i=x0 ; i<x1 ; i++)
+      if(src[i] != key) dst[i] = src[i];
+  }
+
+  return(e->w);
+}
+
+//
+// Same as textCacheDraw(), but caches each character separately
+//
+int textCacheDrawGlyphs(const char *text, int x, int y, uint8_t font, uint8_t datum, uint16_t color)
+{
+  char glyph[2] = { 0, 0 };
+  int width = 0;
+
+  if(datum>MR_DATUM || !psramFound() || !spr.getPointer())
+    return(textCacheDraw(text, x, y, font, datum, color));
+
+  for(const char *p=text ; *p ; p++)
+  {
+    glyph[0] = *p;
+    width += textCacheWidth(glyph, font, color);
+  }
+
+  // Apply horizontal datum, then draw glyphs left to right
+  switch(datum % 3)
+  {
+    case 1: x -= width / 2; break;
+    case 2: x -= width; break;
+  }
+
+  for(const char *p=text ; *p ; p++)
+  {
+    glyph[0] = *p;
+    x += textCacheDraw(glyph, x, y, font, datum - datum % 3, color);
+  }
+
+  return(width);
+}
@@ -16,6 +16,7 @@ static bool sleep_on = false;
 
 // Current SSB patch status
 static bool ssbLoaded = false;
+static uint32_t ssbLoadTime = 0;
 
 // Time
 static bool clockHasBeenSet = false;
@@ -76,17 +77,101 @@ void loadSSB(uint8_t bandwidth, bool draw)
   if(!ssbLoaded)
   {
     if(draw) drawMessage("Loading SSB");
-    rx.loadPatch(ssb_patch_content, sizeof(ssb_patch_content), bandwidth);
+
+    // Fall back to the slower library loader if the fast one fails,
+    // both start over by resetting the chip
+    uint32_t start = millis();
+    if(!rx.loadPatchFast(ssb_patch_content, sizeof(ssb_patch_content), bandwidth))
+      rx.loadPatch(ssb_patch_content, sizeof(ssb_patch_content), bandwidth);
+
+    ssbLoadTime = millis() - start;
     ssbLoaded = true;
   }
 }
 
+//
+// Get time it took to load the SSB patch (ms), 0 if never loaded
+//
+uint32_t ssbGetLoadTime()
+{
+  return(ssbLoadTime);
+}
+
 void unloadSSB()
 {
   // Just mark SSB patch as unloaded
   ssbLoaded = false;
 }
 
+//
+// Mute sequencer
+//
+// The external mute circuit and the amplifier are switched right away,
+// while the SI4735 mute follows after MUTE_SETTLE_TIME, once the mute
+// circuit has settled. The wait runs in muteTickTime(), so that muting
+// does not stall the main loop. When unmuting, the amplifier is enabled
+// last, which also keeps PIN_AMP_EN low for at least MUTE_SETTLE_TIME.
+//
+#define MUTE_SETTLE_TIME    50  // Mute circuit settling time (ms)
+
+#define MUTE_STATE_ON       0   // Sound on
+#define MUTE_STATE_MUTING   1   // Mute circuit on, SI4735 not muted yet
+#define MUTE_STATE_OFF      2   // Sound off
+#define MUTE_STATE_UNMUTING 3   // Mute circuit off, SI4735 not unmuted yet
+
+static uint8_t muteState = MUTE_STATE_ON;
+static uint32_t muteTime = 0;
+
+static void muteStart(bool mute)
+{
+  if(mute && (muteState==MUTE_STATE_ON || muteState==MUTE_STATE_UNMUTING))
+  {
+    // Disable audio amplifier to silence speaker
+    digitalWrite(PIN_AMP_EN, LOW);
+    // Activate the mute circuit
+    digitalWrite(AUDIO_MUTE, HIGH);
+    muteState = MUTE_STATE_MUTING;
+    muteTime = millis();
+  }
+  else if(!mute && (muteState==MUTE_STATE_OFF || muteState==MUTE_STATE_MUTING))
+  {
+    // Deactivate the mute circuit
+    digitalWrite(AUDIO_MUTE, LOW);
+    muteState = MUTE_STATE_UNMUTING;
+    muteTime = millis();
+  }
+}
+
+//
+// Advance mute sequencer. Called from the main loop.
+//
+void muteTickTime()
+{
+  if(muteIsSettled() || (millis() - muteTime) < MUTE_SETTLE_TIME) return;
+
+  if(muteState==MUTE_STATE_MUTING)
+  {
+    rx.setAudioMute(true);
+    muteState = MUTE_STATE_OFF;
+  }
+  else
+  {
+    rx.setAudioMute(false);
+    // Enable audio amplifier to restore speaker output
+    digitalWrite(PIN_AMP_EN, HIGH);
+    muteState = MUTE_STATE_ON;
+  }
+}
+
+//
+// Returns true if no mute transition is in progress. Scanning, seeking
+// and AF sampling wait for this before tuning away.
+//
+bool muteIsSettled()
+{
+  return(muteState==MUTE_STATE_ON || muteState==MUTE_STATE_OFF);
+}
+
 //
 // Mute sound on (x=1) or off (x=0), or get current status (x=2)
 // Do not call this too often because a short PIN_AMP_EN impulse can trigger amplifier mode D,
@@ -156,23 +241,9 @@ bool muteOn(uint8_t mode, int x)
     }
   }
 
-  if(mute) {
-    // Disable audio amplifier to silence speaker
-    digitalWrite(PIN_AMP_EN, LOW);
-    // Activate the mute circuit
-    digitalWrite(AUDIO_MUTE, HIGH);
-    delay(50);
-    rx.setAudioMute(true);
-  }
-
-  if(unmute) {
-    // Deactivate the mute circuit
-    digitalWrite(AUDIO_MUTE, LOW);
-    delay(50);
-    rx.setAudioMute(false);
-    // Enable audio amplifier to restore speaker output
-    digitalWrite(PIN_AMP_EN, HIGH);
-  }
+  // Finished later, in muteTickTime()
+  if(mute) muteStart(true);
+  if(unmute) muteStart(false);
 
   switch(mode) {
   case MUTE_MAIN:
@@ -196,9 +267,9 @@ bool sleepOn(int x)
     sleep_on = true;
     ledcWrite(PIN_LCD_BL, 0);
     spr.fillSprite(TFT_BLACK);
-    spr.pushSprite(0, 0);
-    tft.writecommand(ST7789_DISPOFF);
-    tft.writecommand(ST7789_SLPIN);
+    drawPushSprite();
+    drawDisplayCommand(ST7789_DISPOFF);
+    drawDisplayCommand(ST7789_SLPIN);
 
     // Wait till the button is released to prevent immediate wakeup
     while(pb1.update(digitalRead(ENCODER_PUSH_BUTTON) == LOW).isPressed)
@@ -250,9 +321,9 @@ bool sleepOn(int x)
   else if((x==0) && sleep_on)
   {
     sleep_on = false;
-    tft.writecommand(ST7789_SLPOUT);
+    drawDisplayCommand(ST7789_SLPOUT);
     delay(120);
-    tft.writecommand(ST7789_DISPON);
+    drawDisplayCommand(ST7789_DISPON);
     drawScreen();
     ledcWrite(PIN_LCD_BL, currentBrt);
     // Wait till the button is released to prevent the main loop clicks
@@ -11,6 +11,7 @@
 // SSB patch functions
 void loadSSB(uint8_t bandwidth, bool draw = true);
 void unloadSSB();
+uint32_t ssbGetLoadTime();
 
 // Get firmware version
 const char *getVersion(bool shorter = false);
@@ -24,6 +25,8 @@ int getStrength(int rssi);
 // Set, reset, toggle, or query switches
 bool sleepOn(int x = 2);
 bool muteOn(uint8_t mode, int x = 2);
+void muteTickTime();
+bool muteIsSettled();
 
 // Wall clock functions
 const char *clockGet();
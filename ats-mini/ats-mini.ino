@@ -4,7 +4,7 @@
 
 #include "Common.h"
 #include <Wire.h>
-#include "Rotary.h"
+#include "Encoder.h"
 #include "Button.h"
 #include "Menu.h"
 #include "Draw.h"
@@ -22,9 +22,13 @@
 #define STRENGTH_CHECK_TIME   1500  // Not used
 #define RDS_CHECK_TIME         250  // Increased from 90
 #define SEEK_TIMEOUT        600000  // Max seek timeout (ms)
+#define SEEK_POLL_TIME          20  // Seek progress polling interval (ms)
+#define USEBAND_TIMEOUT        100  // Max wait for tuning after switching bands (ms)
 #define NTP_CHECK_TIME       60000  // NTP time refresh period (ms)
 #define SCHEDULE_CHECK_TIME   2000  // How often to identify the same frequency (ms)
 #define BACKGROUND_REFRESH_TIME 5000    // Background screen refresh time. Covers the situation where there are no other events causing a refresh
+#define MIN_FRAME_TIME          33  // Minimum time between screen redraws (ms), caps the frame rate at ~30 fps
+#define MAX_FRAME_DELAY        100  // Maximum time a redraw can be postponed by the encoder input (ms)
 
 // =================================
 // CONSTANTS AND VARIABLES
@@ -37,6 +41,12 @@ int8_t softMuteMaxAttIdx = 4;
 
 bool seekStop = false;        // G8PTN: Added flag to abort seeking on rotary encoder detection
 bool pushAndRotate = false;   // Push and rotate is active, ignore the long press
+bool seekRunning = false;     // Seek is in progress, see seekTickTime()
+bool seekStarted = false;     // Chip seek has been started, see seekStart()
+int8_t seekDir = 0;           // Seek direction (1 = up, -1 = down)
+uint8_t seekBandIdx = 0;      // Band the seek has been started in
+uint32_t seekStartTime = 0;   // Seek start time (ms)
+uint32_t seekPollTime = 0;    // Last seek progress poll time (ms)
 
 long elapsedRSSI = millis();
 long elapsedButton = millis();
@@ -47,8 +57,6 @@ long lastNTPCheck = millis();
 long lastScheduleCheck = millis();
 
 long elapsedCommand = millis();
-volatile int16_t encoderCount = 0;
-volatile int16_t encoderCountAccel = 0;
 uint16_t currentFrequency;
 
 // AGC/ATTN index per mode (FM/AM/SSB)
@@ -78,6 +86,10 @@ int8_t scrollDirection = 1;             // Menu scroll direction
 // Background screen refresh
 uint32_t background_timer = millis();   // Background screen refresh timer.
 
+// Redraw governor
+static bool redrawPending = false;      // Screen changed since the last redraw
+static uint32_t lastFrameTime = 0;      // Time of the last redraw
+
 //
 // Current parameters
 //
@@ -91,7 +103,6 @@ uint8_t  snr  = 0;
 //
 // Devices
 //
-Rotary encoder  = Rotary(ENCODER_PIN_B, ENCODER_PIN_A);
 ButtonTracker pb1 = ButtonTracker();
 TFT_eSPI tft    = TFT_eSPI();
 TFT_eSprite spr = TFT_eSprite(&tft);
@@ -179,6 +190,8 @@ void setup()
 
   // Initialize flash file system
   diskInit();
+  // Load FM station names remembered from RDS
+  stationDbInit();
 
   // Check for SI4732 connected on I2C interface
   // If the SI4732 is not detected, then halt with no further processing
@@ -195,6 +208,9 @@ void setup()
     while(1);
   }
 
+  // Done with direct display access, set up screen transfers
+  drawInit();
+
   rx.setup(RESET_PIN, MW_BAND_TYPE);
   // Comment the line above and uncomment the three lines below if you are using external ref clock (active crystal or signal generator)
   // rx.setRefClock(32768);
@@ -241,11 +257,9 @@ void setup()
   drawScreen();
   ledcWrite(PIN_LCD_BL, currentBrt);
 
-  // Interrupt actions for Rotary encoder
+  // Start reading the rotary encoder (see Encoder.cpp)
   // Note: Moved to end of setup to avoid inital interrupt actions
-  // ICACHE_RAM_ATTR void rotaryEncoder(); see rotaryEncoder implementation below.
-  attachInterrupt(digitalPinToInterrupt(ENCODER_PIN_A), rotaryEncoder, CHANGE);
-  attachInterrupt(digitalPinToInterrupt(ENCODER_PIN_B), rotaryEncoder, CHANGE);
+  encoderInit();
 
   // Connect WiFi, if necessary
   netInit(wifiModeIdx);
@@ -255,83 +269,14 @@ void setup()
 }
 
 
-int16_t accelerateEncoder(int8_t dir)
-{
-  const uint32_t speedThresholds[] = {350, 60, 45, 35, 25}; // ms between clicks
-  const uint16_t accelFactors[] =      {1,  2,  4,  8, 16}; // corresponding multipliers
-  static uint32_t lastEncoderTime = 0;
-  static uint32_t lastSpeed = speedThresholds[0];
-  static uint16_t lastAccelFactor = accelFactors[0];
-  static int8_t lastEncoderDir = 0;
-
-  uint32_t currentTime = millis();
-  lastSpeed = ((currentTime - lastEncoderTime) * 7 + lastSpeed * 3) / 10;
-
-  // Reset acceleration on timeout or direction change
-  if (lastSpeed > speedThresholds[0] || lastEncoderDir != dir) {
-    lastSpeed = speedThresholds[0];
-    lastAccelFactor = accelFactors[0];
-  } else {
-    // Lookup acceleration factor
-    for (int8_t i = LAST_ITEM(speedThresholds); i >= 0; i--) {
-      if (lastSpeed <= speedThresholds[i] && lastAccelFactor < accelFactors[i]) {
-        lastAccelFactor = accelFactors[i];
-        break;
-      }
-    }
-  }
-  lastEncoderTime = currentTime;
-  lastEncoderDir = dir;
-
-  // Apply acceleration with direction
-  return(dir * lastAccelFactor);
-}
-
-//
-// Reads encoder via interrupt
-// Uses Rotary.h and Rotary.cpp implementation to process encoder via
-// interrupt. If you do not add ICACHE_RAM_ATTR declaration, the system
-// will reboot during attachInterrupt call. The ICACHE_RAM_ATTR macro
-// places this function into RAM.
-//
-ICACHE_RAM_ATTR void rotaryEncoder()
-{
-  // Rotary encoder events
-  uint8_t encoderStatus = encoder.process();
-  if(encoderStatus)
-  {
-    int8_t delta = encoderStatus==DIR_CW? 1 : -1;
-    int16_t accelDelta = accelerateEncoder(delta);
-
-    // Do not accumulate too many encoder steps if event loop doesn't consume them
-    if(abs(encoderCount) < 5)
-    {
-      encoderCount += delta;
-      encoderCountAccel += accelDelta;
-    }
-
-    // Reset the seek flag (but not during scans - only button click should stop scan)
-    if(!scanIsRadioRunning()) seekStop = true;
-  }
-}
-
-uint32_t consumeEncoderCounts()
-{
-  int16_t encCount, encCountAccel;
-  noInterrupts();
-  encCount = encoderCount;
-  encCountAccel = encoderCountAccel;
-  encoderCount = 0;
-  encoderCountAccel = 0;
-  interrupts();
-  return ((uint32_t)encCountAccel << 16) | ((uint16_t)encCount & 0xFFFF);
-}
-
 //
 // Switch radio to given band
 //
 void useBand(const Band *band)
 {
+  // Band and mode changes take over from a running seek
+  seekAbort();
+
   // Set current frequency and mode, reset BFO
   currentFrequency = band->currentFreq;
   currentMode = band->bandMode;
@@ -351,7 +296,7 @@ void useBand(const Band *band)
 
     rx.setFMDeEmphasis(fmRegions[FmRegionIdx].value);
     rx.RdsInit();
-    rx.setRdsConfig(1, 2, 2, 2, 2);
+    rx.setRdsConfig(1, 3, 3, 3, 3); // Errors are weighed per block in Rds.cpp
     rx.setGpioCtl(1, 0, 0);   // G8PTN: Enable GPIO1 as output
     rx.setGpio(0, 0, 0);      // G8PTN: Set GPIO1 = 0
   }
@@ -402,8 +347,8 @@ void useBand(const Band *band)
   doAgc(0);
   // Set currentAVC values based on mode (AM, SSB)
   doAvc(0);
-  // Wait a bit for things to calm down
-  delay(100);
+  // Wait for the chip to finish tuning instead of a fixed delay
+  rx.waitTuneComplete(USEBAND_TIMEOUT);
   // Clear signal strength readings
   rssi = 0;
   snr  = 0;
@@ -480,6 +425,9 @@ bool updateFrequency(int newFreq, bool wrap)
 {
   Band *band = getCurrentBand();
 
+  // Tuning from anywhere (remote, web, AF, ...) ends a running seek
+  seekAbort();
+
   // Do not let new frequency exceed band limits
   if(newFreq < band->minimumFreq)
   {
@@ -508,6 +456,7 @@ bool updateFrequency(int newFreq, bool wrap)
 bool checkStopSeeking()
 {
   // Returns true if the user rotates the encoder
+  encoderPoll();
   if(seekStop) return true;
 
   // Checking isPressed without debouncing because this callback
@@ -523,11 +472,126 @@ bool checkStopSeeking()
   return false;
 }
 
-// This function is called by the seek function process.
-void showFrequencySeek(uint16_t freq)
+//
+// Finish seeking at the frequency the chip has stopped at
+//
+void seekFinish()
 {
+  seekRunning = false;
+  updateFrequency(rx.getFrequency(), true);
+
+  // Check for named frequencies
+  clearStationInfo();
+  identifyFrequency(currentFrequency + currentBFO / 1000);
+
+  // Enable amp
+  muteOn(MUTE_TEMP, false);
+  prefsRequestSave(SAVE_CUR_BAND);
+}
+
+//
+// Stop seeking at the current frequency
+//
+void seekCancel()
+{
+  if(!seekRunning) return;
+  rx.seekStationCancel();
+  seekFinish();
+}
+
+//
+// Drop a running seek without retuning, for callers that are about to
+// tune the chip themselves
+//
+void seekAbort()
+{
+  if(!seekRunning) return;
+  rx.seekStationCancel();
+  seekRunning = false;
+  muteOn(MUTE_TEMP, false);
+}
+
+bool seekIsRunning()
+{
+  return(seekRunning);
+}
+
+//
+// Start seeking once the mute circuit has settled, returns true if
+// the frequency has changed
+//
+bool seekStart()
+{
+  if(!muteIsSettled()) return(false);
+
+  // updateFrequency() below must not drop this seek
+  seekRunning = false;
+
+  // Jump straight to the next station found by a recent scan,
+  // confirming that it is still there with a single RSSI read
+  uint8_t threshold;
+  uint16_t freq = scanFindStation(bandIdx, currentFrequency, seekDir, &threshold);
+  bool found = false;
+  if(freq && updateFrequency(freq, false))
+  {
+    rx.waitTuneComplete(USEBAND_TIMEOUT);
+    rx.getCurrentReceivedSignalQuality();
+    found = rx.getCurrentRSSI() >= threshold;
+  }
+
+  // Otherwise let the chip seek, seekTickTime() will unmute once
+  // a station is found
+  if(!found && rx.seekStationStart(seekDir>0? 1 : 0))
+  {
+    seekRunning   = true;
+    seekStarted   = true;
+    seekStartTime = seekPollTime = millis();
+    return(true);
+  }
+
+  // Check for named frequencies
+  identifyFrequency(currentFrequency + currentBFO / 1000);
+  // Enable amp
+  muteOn(MUTE_TEMP, false);
+  return(true);
+}
+
+//
+// Tick seek, called from the main loop instead of blocking in
+// SI4735::seekStationProgress(). Returns true if the frequency has
+// changed and the screen needs to be redrawn.
+//
+bool seekTickTime()
+{
+  if(!seekRunning) return(false);
+
+  // Band has been changed from elsewhere, drop the seek
+  if(bandIdx!=seekBandIdx || isSSB())
+  {
+    seekRunning = false;
+    muteOn(MUTE_TEMP, false);
+    return(true);
+  }
+
+  if(!seekStarted) return(seekStart());
+
+  // Let the chip seek, polling it every SEEK_POLL_TIME
+  uint32_t now = millis();
+  if((now - seekPollTime) < SEEK_POLL_TIME) return(false);
+  seekPollTime = now;
+
+  // Stop when the seek is complete or has timed out
+  uint16_t freq;
+  if(!rx.seekStationPoll(&freq) || (now - seekStartTime) >= SEEK_TIMEOUT)
+  {
+    seekCancel();
+    return(true);
+  }
+
+  // Redraws are rate limited by the main loop
+  if(freq==currentFrequency) return(false);
   currentFrequency = freq;
-  drawScreen();
+  return(true);
 }
 
 //
@@ -549,10 +613,13 @@ bool doSeek(int16_t enc, int16_t enca)
       clearStationInfo();
       rssi = snr = 0;
 
-      // Flag is set by rotary encoder and cleared on seek/scan entry
-      seekStop = false;
-      rx.seekStationProgress(showFrequencySeek, checkStopSeeking, enc>0? 1 : 0);
-      updateFrequency(rx.getFrequency(), true);
+      // Tuning away before the mute circuit has settled is audible,
+      // so seekTickTime() starts seeking a bit later
+      seekRunning = true;
+      seekStarted = false;
+      seekDir     = enc>0? 1 : -1;
+      seekBandIdx = bandIdx;
+      return(true);
     }
   }
   else if(seekMode() == SEEK_SCHEDULE && enc)
@@ -681,9 +748,9 @@ bool processRssiSnr()
   static uint32_t updateCounter = 0;
   bool needRedraw = false;
 
-  rx.getCurrentReceivedSignalQuality();
-  int newRSSI = rx.getCurrentRSSI();
-  int newSNR = rx.getCurrentSNR();
+  // Shared with telemetry streams, so the chip is not queried twice
+  uint8_t newRSSI, newSNR;
+  telemetrySignal(&newRSSI, &newSNR, TELEMETRY_MAX_AGE);
 
   // Apply squelch if the volume is not muted
   if(currentSquelch && currentSquelch <= 127)
@@ -735,8 +802,13 @@ void loop()
 
   ButtonTracker::State pb1st = pb1.update(digitalRead(ENCODER_PUSH_BUTTON) == LOW);
 
+  // Finish muting or unmuting sound
+  muteTickTime();
+
   // Periodically print status to serial
   remoteTickTime();
+  protoTickTime();
+  telemetryTickTime();
 
   // Tick async scan if running (for web API spectrum analyzer)
   scanTickAsync();
@@ -745,25 +817,42 @@ void loop()
   if(scanTickRadio())
     needRedraw = true;
 
+  // Tick seek if running
+  needRedraw |= seekTickTime();
+
   // if(encCount && getCpuFrequencyMhz()!=240) setCpuFrequencyMhz(240);
 
-  // Receive and execute serial command
-  if(Serial.available()>0)
+  // Receive and execute serial and BLE commands, BLE must be served
+  // on every pass even if serial has produced an event
+  int sevent = Serial.available()>0? remoteReceive(REMOTE_SERIAL) : 0;
+  int bevent = bleDoCommand(bleModeIdx);
+  int revent = sevent | bevent;
+  if(revent)
   {
-    int revent = remoteDoCommand(Serial.read());
     needRedraw |= !!(revent & REMOTE_CHANGED);
     pb1st.wasClicked |= !!(revent & REMOTE_CLICK);
-    int direction = revent >> REMOTE_DIRECTION;
+    // Direction is a signed value in the upper bits, add rather than OR
+    int direction = (sevent >> REMOTE_DIRECTION) + (bevent >> REMOTE_DIRECTION);
     encCount = direction? direction : encCount;
     encCountAccel = direction? direction : encCountAccel;
     if(revent & REMOTE_PREFS) prefsRequestSave(SAVE_ALL);
   }
 
-  int ble_event = bleDoCommand(bleModeIdx);
+  // Execute radio commands posted by web and BLE handlers
+  needRedraw |= queueTickTime();
 
   // Block encoder rotation when in the locked sleep mode
   if(encCount && sleepOn() && sleepModeIdx==SLEEP_LOCKED) encCount = encCountAccel = 0;
 
+  // Encoder rotation or click stops seeking
+  if(seekRunning && (encCount || pb1st.wasClicked || pb1st.wasShortPressed))
+  {
+    seekCancel();
+    encCount = encCountAccel = 0;
+    pb1st.wasClicked = pb1st.wasShortPressed = false;
+    needRedraw = true;
+  }
+
   // Activate push and rotate mode (can span multiple loop iterations until the button is released)
   if (encCount && pb1st.isPressed) pushAndRotate = true;
 
@@ -785,6 +874,11 @@ void loop()
           doSelectDigit(encCount);
           needRedraw = true;
           break;
+        case CMD_SCAN:
+          // Zoom scan spectrum in or out
+          doScanZoom(encCount);
+          needRedraw = true;
+          break;
         case CMD_SEEK:
           // Normal tuning in seek mode
           needRedraw |= doTune(encCount);
@@ -898,8 +992,6 @@ void loop()
         case CMD_SEEK:
           // Seek mode
           needRedraw |= doSeek(encCount, encCountAccel);
-          // Seek can take long time, renew the timestamp
-          currentTime = millis();
           // Current frequency may have changed
           prefsRequestSave(SAVE_CUR_BAND);
           break;
@@ -1058,10 +1150,13 @@ void loop()
   // Periodically check received RDS information
   if((currentTime - lastRDSCheck) > RDS_CHECK_TIME)
   {
-    needRedraw |= (currentMode == FM) && (snr >= 12) && checkRds();
+    needRedraw |= (currentMode == FM) && !seekRunning && checkRds();
     lastRDSCheck = currentTime;
   }
 
+  // Switch to a stronger alternative frequency when signal fades
+  needRedraw |= afTickTime();
+
   // Periodically check schedule
   if((currentTime - lastScheduleCheck) > SCHEDULE_CHECK_TIME)
   {
@@ -1080,6 +1175,9 @@ void loop()
   // been no activity for a while
   prefsTickTime();
 
+  // Save newly received FM station names
+  stationDbTickTime();
+
   // Tick NETWORK time, connecting to WiFi if requested
   netTickTime();
 
@@ -1095,8 +1193,21 @@ void loop()
     background_timer = currentTime;
   }
 
-  // Redraw screen if necessary
-  if(needRedraw) drawScreen();
+  // Redraw screen if necessary, but no more often than MIN_FRAME_TIME,
+  // coalescing all changes made in between into a single frame. While
+  // new encoder steps are waiting, process them first and draw once the
+  // input settles (or after MAX_FRAME_DELAY at most)
+  redrawPending |= needRedraw;
+  if(redrawPending)
+  {
+    uint32_t sinceFrame = millis() - lastFrameTime;
+    if((sinceFrame >= MIN_FRAME_TIME) && (!encoderPending() || (sinceFrame >= MAX_FRAME_DELAY)))
+    {
+      drawScreen();
+      lastFrameTime = millis();
+      redrawPending = false;
+    }
+  }
 
   // Add a small default delay in the main loop
   delay(5);
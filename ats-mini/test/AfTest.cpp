@@ -0,0 +1,301 @@
+#include <string.h>
+#include "Test.h"
+#include "../Af.h"
+
+//
+// AF switching logic against a simulated receiver
+//
+
+#define PI_HOME   0x1234
+#define PI_OTHER  0x4321
+
+typedef struct
+{
+  uint16_t freq;
+  uint16_t pi;                // 0 = no RDS
+  uint8_t  rssi;
+} SimStation;
+
+static SimStation simStations[4];
+static int simCount;
+
+static uint32_t simTime;      // Current time (ms)
+static uint32_t simUs;        // Current time (us)
+static uint16_t simFreq;      // Tuned frequency
+static uint32_t simTuneTime;  // When simFreq was tuned
+static uint32_t simPIDelay;   // Time to receive the PI code
+static bool     simRefuse;    // Refuse to tune
+static uint16_t simAfs[4];    // AF list broadcast by the station
+static int      simAfCount;
+static int      simMeasures;  // Number of measure() calls
+static uint16_t simMeasured;  // Last measured frequency
+static int      simResets;    // Number of rdsReset() calls
+static int      simConfirms;  // Number of confirmed() calls
+
+static const SimStation *simStation(uint16_t freq)
+{
+  for(int j=0 ; j<simCount ; j++)
+    if(simStations[j].freq==freq) return(&simStations[j]);
+  return(0);
+}
+
+static uint32_t simMillis() { return(simTime); }
+static uint32_t simMicros() { return(simUs); }
+static uint16_t simFrequency() { return(simFreq); }
+static void simRdsReset() { simResets++; }
+static void simConfirmed() { simConfirms++; }
+
+static bool simTune(uint16_t freq)
+{
+  if(simRefuse) return(false);
+  simFreq = freq;
+  simTuneTime = simTime;
+  return(true);
+}
+
+static uint8_t simMeasure(uint16_t freq)
+{
+  const SimStation *s = simStation(freq);
+  simMeasures++;
+  simMeasured = freq;
+  simUs += 5000;
+  return(s? s->rssi : 0);
+}
+
+static uint8_t simRssi()
+{
+  const SimStation *s = simStation(simFreq);
+  return(s? s->rssi : 0);
+}
+
+static uint16_t simPI()
+{
+  const SimStation *s = simStation(simFreq);
+  return(!s || simTime - simTuneTime < simPIDelay? 0 : s->pi);
+}
+
+static uint8_t simGetAfs(uint16_t *list, uint8_t max)
+{
+  int n = simAfCount < max? simAfCount : max;
+  memcpy(list, simAfs, n * sizeof(*list));
+  return(n);
+}
+
+static const AfReceiver simReceiver =
+{
+  simMillis, simMicros, simFrequency, simTune, simMeasure,
+  simRssi, simPI, simGetAfs, simRdsReset, simConfirmed
+};
+
+//
+// Home station at 90.00 MHz, one AF at 95.00 MHz
+//
+static void simInit(uint8_t homeRssi, uint16_t afPI, uint8_t afRssi)
+{
+  afReset();
+  simStations[0] = (SimStation){ 9000, PI_HOME, homeRssi };
+  simStations[1] = (SimStation){ 9500, afPI, afRssi };
+  simCount    = 2;
+  simAfs[0]   = 9500;
+  simAfCount  = 1;
+  simTime     = 10000;
+  simUs       = 0;
+  simFreq     = 9000;
+  simTuneTime = 0;
+  simPIDelay  = 500;
+  simRefuse   = false;
+  simMeasures = simResets = simConfirms = 0;
+  simMeasured = 0;
+}
+
+static bool check(uint32_t dt, bool enabled = true)
+{
+  simTime += dt;
+  return(afCheck(&simReceiver, enabled));
+}
+
+static void testSwitchConfirmed()
+{
+  simInit(20, PI_HOME, 40);
+
+  CHECK(check(0));
+  CHECK(simFreq==9500);
+  CHECK(simMeasures==1 && simMeasured==9500);
+  CHECK(afGetStats()->checks==1);
+  CHECK(afGetStats()->lastGap==5000);
+
+  // PI code not there yet, keep waiting
+  CHECK(!check(100));
+  CHECK(simFreq==9500);
+  CHECK(!simConfirms);
+
+  CHECK(!check(500));
+  CHECK(simFreq==9500);
+  CHECK(simConfirms==1);
+  CHECK(afGetStats()->switches==1);
+  CHECK(afGetStats()->lastLatency==600);
+  CHECK(!afGetStats()->reverts);
+}
+
+static void testMargin()
+{
+  // 5 dB stronger is not enough
+  simInit(20, PI_HOME, 25);
+  CHECK(!check(0));
+  CHECK(simMeasures==1);
+  CHECK(simFreq==9000);
+
+  // 6 dB stronger is
+  simInit(20, PI_HOME, 26);
+  CHECK(check(0));
+  CHECK(simFreq==9500);
+}
+
+static void testStrongSignal()
+{
+  simInit(30, PI_HOME, 60);
+  CHECK(!check(0));
+  CHECK(!simMeasures);
+  CHECK(simFreq==9000);
+}
+
+static void testCheckInterval()
+{
+  simInit(20, PI_HOME, 21);
+  CHECK(!check(0));
+  CHECK(simMeasures==1);
+
+  CHECK(!check(2999));
+  CHECK(simMeasures==1);
+
+  CHECK(!check(1));
+  CHECK(simMeasures==2);
+}
+
+static void testDisabled()
+{
+  simInit(20, PI_HOME, 40);
+  CHECK(!check(0, false));
+  CHECK(!simMeasures);
+
+  // A pending switch is still verified
+  CHECK(check(0));
+  CHECK(!check(600, false));
+  CHECK(simConfirms==1);
+}
+
+static void testWrongPI()
+{
+  simInit(20, PI_OTHER, 40);
+
+  CHECK(check(0));
+  CHECK(simFreq==9500);
+
+  // Different PI code: switch back at once
+  int resets = simResets;
+  CHECK(check(500));
+  CHECK(simFreq==9000);
+  CHECK(simResets==resets + 1);
+  CHECK(afGetStats()->reverts==1);
+  CHECK(!afGetStats()->switches);
+  CHECK(!simConfirms);
+
+  // The AF is put aside for 10 checks
+  for(int j=0 ; j<10 ; j++) CHECK(!check(3000));
+  CHECK(simMeasures==1);
+
+  CHECK(check(3000));
+  CHECK(simMeasures==2);
+}
+
+static void testNoPI()
+{
+  simInit(20, 0, 40);
+
+  CHECK(check(0));
+  CHECK(!check(1999));
+  CHECK(simFreq==9500);
+
+  CHECK(check(1));
+  CHECK(simFreq==9000);
+  CHECK(afGetStats()->reverts==1);
+}
+
+static void testUserTuned()
+{
+  simInit(20, PI_OTHER, 40);
+
+  CHECK(check(0));
+  simTune(8800);
+
+  // Nothing to verify or revert
+  CHECK(!check(500));
+  CHECK(simFreq==8800);
+  CHECK(!afGetStats()->reverts);
+  CHECK(!afGetStats()->switches);
+}
+
+static void testTuneRefused()
+{
+  simInit(20, PI_HOME, 40);
+  simRefuse = true;
+
+  CHECK(!check(0));
+  CHECK(simFreq==9000);
+
+  // Nothing left pending
+  simRefuse = false;
+  CHECK(!check(500));
+  CHECK(simMeasures==1);
+}
+
+static void testCandidates()
+{
+  simInit(20, PI_HOME, 21);
+  simStations[2] = (SimStation){ 9700, PI_HOME, 22 };
+  simCount = 3;
+
+  // Current frequency in the list is never sampled
+  simAfs[0] = 9000;
+  simAfs[1] = 9500;
+  simAfs[2] = 9700;
+  simAfCount = 3;
+
+  CHECK(!check(0));
+  CHECK(simMeasured==9500);
+  CHECK(!check(3000));
+  CHECK(simMeasured==9700);
+  CHECK(!check(3000));
+  CHECK(simMeasured==9500);
+  CHECK(simMeasures==3);
+}
+
+static void testNoList()
+{
+  simInit(20, PI_HOME, 40);
+  simAfCount = 0;
+  CHECK(!check(0));
+  CHECK(!simMeasures);
+
+  // No PI code, no list to look up
+  simInit(20, PI_HOME, 40);
+  simTuneTime = simTime;
+  CHECK(!check(0));
+  CHECK(!simMeasures);
+}
+
+int main()
+{
+  RUN(testSwitchConfirmed);
+  RUN(testMargin);
+  RUN(testStrongSignal);
+  RUN(testCheckInterval);
+  RUN(testDisabled);
+  RUN(testWrongPI);
+  RUN(testNoPI);
+  RUN(testUserTuned);
+  RUN(testTuneRefused);
+  RUN(testCandidates);
+  RUN(testNoList);
+  return(testResult());
+}
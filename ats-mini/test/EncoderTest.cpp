@@ -0,0 +1,95 @@
+#include "Test.h"
+#include "../Encoder.h"
+
+//
+// Encoder acceleration
+//
+
+static EncoderAccel acc;
+static uint32_t now;
+
+// Turn the encoder for given number of steps, given ms apart,
+// returns the last accelerated step
+static int16_t turn(int8_t dir, uint32_t interval, int steps)
+{
+  int16_t result = 0;
+
+  for(int j=0 ; j<steps ; j++)
+  {
+    now += interval;
+    result = encoderAccelerate(&acc, dir, now);
+  }
+
+  return(result);
+}
+
+static void start()
+{
+  encoderAccelReset(&acc);
+  now = 100000;
+}
+
+static void testFirstStep()
+{
+  start();
+  CHECK(turn(1, 0, 1)==1);
+
+  start();
+  CHECK(turn(-1, 0, 1)==-1);
+}
+
+static void testThresholds()
+{
+  // Steady speed converges to the interval, just above and at each threshold
+  start(); CHECK(turn(1, 100, 30)==1);
+  start(); CHECK(turn(1, 61, 30)==1);
+  start(); CHECK(turn(1, 60, 30)==2);
+  start(); CHECK(turn(1, 46, 30)==2);
+  start(); CHECK(turn(1, 45, 30)==4);
+  start(); CHECK(turn(1, 36, 30)==4);
+  start(); CHECK(turn(1, 35, 30)==8);
+  start(); CHECK(turn(1, 26, 30)==8);
+  start(); CHECK(turn(1, 25, 30)==16);
+  start(); CHECK(turn(1, 5, 30)==16);
+
+  // Same factors counterclockwise
+  start(); CHECK(turn(-1, 60, 30)==-2);
+  start(); CHECK(turn(-1, 25, 30)==-16);
+}
+
+static void testTimeout()
+{
+  start();
+  CHECK(turn(1, 20, 30)==16);
+
+  // Slowing down keeps the factor until the average exceeds 350 ms
+  CHECK(turn(1, 400, 1)==16);
+
+  start();
+  CHECK(turn(1, 20, 30)==16);
+  CHECK(turn(1, 500, 1)==1);
+
+  // Speeds up again from scratch
+  CHECK(turn(1, 60, 1)==1);
+  CHECK(turn(1, 25, 30)==16);
+}
+
+static void testReversal()
+{
+  start();
+  CHECK(turn(1, 20, 30)==16);
+
+  // Any direction change resets acceleration, however fast
+  CHECK(turn(-1, 20, 1)==-1);
+  CHECK(turn(-1, 20, 30)==-16);
+  CHECK(turn(1, 20, 1)==1);
+}
+
+int main()
+{
+  RUN(testFirstStep);
+  RUN(testThresholds);
+  RUN(testTimeout);
+  RUN(testReversal);
+  return(testResult());
+}
@@ -0,0 +1,34 @@
+#ifndef TEST_H
+#define TEST_H
+
+//
+// Minimal host test helpers, see "make test"
+//
+
+#include <stdio.h>
+
+static int testFailures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if(!(cond)) \
+    { \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      testFailures++; \
+    } \
+  } while(0)
+
+#define RUN(test) \
+  do { \
+    printf("%s\n", #test); \
+    test(); \
+  } while(0)
+
+static inline int testResult()
+{
+  if(testFailures) printf("%d check(s) failed\n", testFailures);
+  else printf("All checks passed\n");
+  return(testFailures? 1 : 0);
+}
+
+#endif // TEST_H